@@ -1,5 +1,7 @@
+#define _GNU_SOURCE // sched_setaffinity, cpu_set_t
 #include <errno.h>
 #include <stdbool.h>
+#include <stdint.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
@@ -9,10 +11,27 @@
 #include <sys/file.h>
 #include <ctype.h>
 #include <dirent.h>
+#include <fcntl.h>
+#include <limits.h>
+#include <arpa/inet.h>
+#include <poll.h>
+#include <sched.h>
+#include <signal.h>
+#include <sys/sendfile.h>
+#include <sys/inotify.h>
+#include <sys/mman.h>
+#include <sys/resource.h>
+#include <sys/signalfd.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/syscall.h>
+#include <time.h>
 
 
 const char *sysname = "mishell";
 
+int last_status = 0; // exit status of the last foreground command
+
 enum return_codes {
 	SUCCESS = 0,
 	EXIT = 1,
@@ -26,9 +45,45 @@ struct command_t {
 	int arg_count; // arg_count = name + ... + NULL
 	char **args;
 	char *redirects[3]; // in/out redirection  //0 read 1 write 2 append
+	struct sched_options *sched; // "on" prefix, NULL without one
+	bool resolved; // args[0] holds the path find_executable() found
+	bool cached; // owned by the line cache, not freed after running
 	struct command_t *next; // for piping
 };
 
+int process_command(struct command_t *command);
+void parse_sched_prefix(struct command_t *command);
+
+//growable byte buffer, used for substitution output and argument building
+struct strbuf {
+	char *data;
+	size_t len;
+	size_t cap;
+};
+
+//make room for n more bytes plus the terminating NUL
+void strbuf_reserve(struct strbuf *sb, size_t n) {
+	if (sb->len + n + 1 > sb->cap) {
+		size_t cap = sb->cap ? sb->cap : 64;
+		while (sb->len + n + 1 > cap)
+			cap *= 2;
+		sb->data = realloc(sb->data, cap);
+		sb->cap = cap;
+		sb->data[sb->len] = '\0';
+	}
+}
+
+void strbuf_append(struct strbuf *sb, const char *s, size_t n) {
+	strbuf_reserve(sb, n);
+	memcpy(sb->data + sb->len, s, n);
+	sb->len += n;
+	sb->data[sb->len] = '\0';
+}
+
+void strbuf_puts(struct strbuf *sb, const char *s) {
+	strbuf_append(sb, s, strlen(s));
+}
+
 
 /**
  * Prints a command struct
@@ -81,6 +136,7 @@ int free_command(struct command_t *command) {
 		command->next = NULL;
 	}
 
+	free(command->sched);
 	free(command->name);
 	free(command);
 	return 0;
@@ -98,6 +154,608 @@ int show_prompt() {
 	return 0;
 }
 
+//list of words produced by expanding one token
+struct word_list {
+	char **words;
+	int count;
+	int cap;
+};
+
+void word_list_add(struct word_list *list, char *word) {
+	if (list->count == list->cap) {
+		list->cap = list->cap ? list->cap * 2 : 8;
+		list->words = realloc(list->words, list->cap * sizeof(char *));
+	}
+	list->words[list->count++] = word;
+}
+
+//FNV-1a, used to index the small hash tables of the shell
+unsigned long hash_string(const char *s) {
+	unsigned long h = 14695981039346656037UL;
+	for (; *s; s++) {
+		h ^= (unsigned char)*s;
+		h *= 1099511628211UL;
+	}
+	return h;
+}
+
+unsigned long hash_bytes(const char *s, int len) {
+	unsigned long h = 14695981039346656037UL;
+	for (int i = 0; i < len; i++) {
+		h ^= (unsigned char)s[i];
+		h *= 1099511628211UL;
+	}
+	return h;
+}
+
+//directory listing, read once per line however many patterns use it
+struct dir_listing {
+	char *path;
+	char *names; // all entry names, NUL separated
+	size_t *offsets; // sorted by name
+	int count;
+	struct dir_listing *next;
+};
+
+#define DIRCACHE_BUCKETS 256
+struct dir_listing *dircache[DIRCACHE_BUCKETS];
+
+struct dir_listing *sort_listing; // qsort has no context argument
+int compare_listing_names(const void *a, const void *b) {
+	return strcmp(sort_listing->names + *(const size_t *)a,
+				  sort_listing->names + *(const size_t *)b);
+}
+
+/**
+ * Sorted entries of a directory, from the per-line cache when possible
+ * @return NULL if the directory cannot be read
+ */
+struct dir_listing *dircache_get(const char *path) {
+	unsigned long bucket = hash_string(path) % DIRCACHE_BUCKETS;
+	struct dir_listing *d;
+
+	for (d = dircache[bucket]; d; d = d->next) {
+		if (strcmp(d->path, path) == 0)
+			return d->count >= 0 ? d : NULL;
+	}
+
+	d = calloc(1, sizeof(struct dir_listing));
+	d->path = strdup(path);
+	d->next = dircache[bucket];
+	dircache[bucket] = d;
+
+	DIR *dir = opendir(path);
+	if (dir == NULL) {
+		d->count = -1; // remember the failure too
+		return NULL;
+	}
+
+	struct strbuf names = {0};
+	size_t cap = 0;
+	struct dirent *entry;
+	while ((entry = readdir(dir)) != NULL) {
+		if (strcmp(entry->d_name, ".") == 0 || strcmp(entry->d_name, "..") == 0)
+			continue;
+		if ((size_t)d->count == cap) {
+			cap = cap ? cap * 2 : 64;
+			d->offsets = realloc(d->offsets, cap * sizeof(size_t));
+		}
+		d->offsets[d->count++] = names.len;
+		strbuf_append(&names, entry->d_name, strlen(entry->d_name) + 1);
+	}
+	closedir(dir);
+	d->names = names.data;
+
+	sort_listing = d;
+	qsort(d->offsets, d->count, sizeof(size_t), compare_listing_names);
+	return d;
+}
+
+//forget the listings once a line has run, the next one may see changes
+void dircache_clear() {
+	for (int i = 0; i < DIRCACHE_BUCKETS; i++) {
+		while (dircache[i]) {
+			struct dir_listing *d = dircache[i];
+			dircache[i] = d->next;
+			free(d->path);
+			free(d->names);
+			free(d->offsets);
+			free(d);
+		}
+	}
+}
+
+/**
+ * Match one pattern element ('?', '[...]', '\x' or a literal) against c
+ * @return length of the element, 0 if it does not match
+ */
+int glob_match_one(const char *p, char c) {
+	if (*p == '?')
+		return 1;
+	if (*p == '\\' && p[1])
+		return p[1] == c ? 2 : 0;
+	if (*p != '[')
+		return *p == c ? 1 : 0;
+
+	// bracket expression, a ']' right after the opening is literal
+	const char *q = p + 1;
+	bool negate = false, found = false;
+	if (*q == '!' || *q == '^') {
+		negate = true;
+		q++;
+	}
+	const char *first = q;
+	while (*q && (*q != ']' || q == first)) {
+		if (q[1] == '-' && q[2] && q[2] != ']') {
+			if ((unsigned char)c >= (unsigned char)q[0] && (unsigned char)c <= (unsigned char)q[2])
+				found = true;
+			q += 3;
+		} else {
+			if (*q == c)
+				found = true;
+			q++;
+		}
+	}
+	if (*q != ']') // unterminated, a plain '['
+		return c == '[' ? 1 : 0;
+	return found != negate ? (int)(q - p + 1) : 0;
+}
+
+/**
+ * Shell pattern match of a single file name. Only the last '*' is ever
+ * backtracked to, so this is O(len(p) * len(s)) at worst, never exponential.
+ */
+bool glob_match(const char *p, const char *s) {
+	const char *star_p = NULL, *star_s = NULL;
+
+	while (*s) {
+		if (*p == '*') {
+			while (*p == '*')
+				p++;
+			star_p = p;
+			star_s = s;
+			continue;
+		}
+		int n = *p ? glob_match_one(p, *s) : 0;
+		if (n > 0) {
+			p += n;
+			s++;
+		} else if (star_p) {
+			p = star_p;
+			s = ++star_s;
+		} else {
+			return false;
+		}
+	}
+	while (*p == '*')
+		p++;
+	return *p == '\0';
+}
+
+bool has_glob_chars(const char *s) {
+	return strpbrk(s, "*?[") != NULL;
+}
+
+/**
+ * Expand the pattern components from index k on, below prefix
+ */
+void glob_components(char **parts, int nparts, int k, struct strbuf *prefix,
+					 struct word_list *out) {
+	if (k == nparts) {
+		struct stat st;
+		if (lstat(prefix->data, &st) == 0)
+			word_list_add(out, strdup(prefix->data));
+		return;
+	}
+
+	size_t mark = prefix->len;
+	if (!has_glob_chars(parts[k])) {
+		if (prefix->len > 0 && prefix->data[prefix->len - 1] != '/')
+			strbuf_puts(prefix, "/");
+		strbuf_puts(prefix, parts[k]);
+		glob_components(parts, nparts, k + 1, prefix, out);
+		prefix->len = mark;
+		prefix->data[mark] = '\0';
+		return;
+	}
+
+	struct dir_listing *d = dircache_get(prefix->len ? prefix->data : ".");
+	if (d == NULL)
+		return;
+	for (int i = 0; i < d->count; i++) {
+		const char *name = d->names + d->offsets[i];
+		if (name[0] == '.' && parts[k][0] != '.')
+			continue; // hidden files need an explicit dot
+		if (!glob_match(parts[k], name))
+			continue;
+		if (prefix->len > 0 && prefix->data[prefix->len - 1] != '/')
+			strbuf_puts(prefix, "/");
+		strbuf_puts(prefix, name);
+		if (k + 1 == nparts)
+			word_list_add(out, strdup(prefix->data)); // listed, so it exists
+		else
+			glob_components(parts, nparts, k + 1, prefix, out);
+		prefix->len = mark;
+		prefix->data[mark] = '\0';
+	}
+}
+
+int compare_words(const void *a, const void *b) {
+	return strcmp(*(char *const *)a, *(char *const *)b);
+}
+
+/**
+ * Expand a glob pattern into the sorted list of matching paths
+ * @return false if nothing matched (the word is then kept literally)
+ */
+bool glob_expand(const char *pattern, struct word_list *out) {
+	char *copy = strdup(pattern);
+	char **parts = NULL;
+	int nparts = 0, globbed = 0, first = out->count;
+	struct strbuf prefix = {0};
+
+	strbuf_reserve(&prefix, PATH_MAX);
+	prefix.data[0] = '\0';
+	if (copy[0] == '/')
+		strbuf_puts(&prefix, "/");
+
+	// strtok_r, parse_command() is in the middle of its own strtok
+	char *save;
+	for (char *part = strtok_r(copy, "/", &save); part; part = strtok_r(NULL, "/", &save)) {
+		parts = realloc(parts, (nparts + 1) * sizeof(char *));
+		parts[nparts++] = part;
+		globbed += has_glob_chars(part);
+	}
+
+	glob_components(parts, nparts, 0, &prefix, out);
+
+	// directory listings are sorted, one globbed level needs no extra sort
+	if (globbed > 1)
+		qsort(out->words + first, out->count - first, sizeof(char *), compare_words);
+
+	free(prefix.data);
+	free(parts);
+	free(copy);
+	return out->count > first;
+}
+
+//output of the $(...) of the current line. The line parse_command() sees
+//only holds a marker for each, so the output is split into words but
+//never read as redirections or pipes
+#define CAPTURE_MARK '\x1f'
+char **captures = NULL;
+int capture_count = 0;
+int capture_cap = 0;
+
+/**
+ * Append the output a capture marker, s[0] == CAPTURE_MARK, stands for
+ * @return characters of s consumed
+ */
+int expand_capture(const char *s, struct strbuf *out) {
+	char *end;
+	long index = isdigit((unsigned char)s[1]) ? strtol(s + 1, &end, 10) : -1;
+	if (index < 0 || index >= capture_count || *end != CAPTURE_MARK) {
+		strbuf_append(out, s, 1); // typed by the user, keep it
+		return 1;
+	}
+	strbuf_puts(out, captures[index]);
+	return end + 1 - s;
+}
+
+/**
+ * Replace the capture markers of a redirection target
+ * @return newly allocated string
+ */
+char *expand_captures(const char *s) {
+	struct strbuf out = {0};
+	strbuf_reserve(&out, strlen(s));
+	for (int i = 0; s[i];) {
+		if (s[i] == CAPTURE_MARK)
+			i += expand_capture(s + i, &out);
+		else
+			strbuf_append(&out, s + i++, 1);
+	}
+	return out.data;
+}
+
+/**
+ * Append the value of $NAME, ${NAME}, $? or $$ starting at s[0] == '$'
+ * @return characters of s consumed
+ */
+int expand_variable(const char *s, struct strbuf *out) {
+	char number[32];
+
+	if (s[1] == '?') {
+		snprintf(number, sizeof(number), "%d", last_status);
+		strbuf_puts(out, number);
+		return 2;
+	}
+	if (s[1] == '$') {
+		snprintf(number, sizeof(number), "%d", (int)getpid());
+		strbuf_puts(out, number);
+		return 2;
+	}
+
+	bool braced = s[1] == '{';
+	const char *name = s + 1 + braced;
+	int len = 0;
+	while (isalnum((unsigned char)name[len]) || name[len] == '_')
+		len++;
+	if (len == 0 || (braced && name[len] != '}')) {
+		strbuf_append(out, "$", 1); // not a variable, keep it
+		return 1;
+	}
+
+	char *key = strndup(name, len);
+	const char *value = getenv(key);
+	free(key);
+	if (value)
+		strbuf_puts(out, value);
+	return 1 + braced + len + braced;
+}
+
+bool brace_has_alternatives(const char *open, const char *close) {
+	int depth = 0;
+	for (const char *q = open + 1; q < close; q++) {
+		if (*q == '{')
+			depth++;
+		else if (*q == '}')
+			depth--;
+		else if (depth == 0 && (*q == ',' || (q[0] == '.' && q[1] == '.')))
+			return true;
+	}
+	return false;
+}
+
+/**
+ * Brace expansion: a{b,c}d -> abd acd, {1..3} -> 1 2 3, nesting allowed
+ */
+void expand_braces(const char *word, struct word_list *out) {
+	const char *open = NULL, *close = NULL;
+	int depth = 0;
+
+	// first brace pair that has a top level comma or a range
+	for (const char *p = word; *p; p++) {
+		if (*p == '{') {
+			if (depth++ == 0)
+				open = p;
+		} else if (*p == '}' && depth > 0 && --depth == 0 && brace_has_alternatives(open, p)) {
+			close = p;
+			break;
+		}
+	}
+	if (close == NULL) {
+		word_list_add(out, strdup(word));
+		return;
+	}
+
+	struct word_list alts = {0};
+	char *body = strndup(open + 1, close - open - 1);
+	long from, to, step = 1;
+	char a, b;
+	int width = 0;
+
+	if (sscanf(body, "%ld..%ld..%ld", &from, &to, &step) >= 2 && strchr(body, ',') == NULL) {
+		// numeric range, zero padded when either end is
+		if (body[0] == '0' || (body[0] == '-' && body[1] == '0') || strstr(body, "..0"))
+			width = strcspn(body, ".");
+		step = step < 0 ? -step : (step ? step : 1);
+		for (long i = from; from <= to ? i <= to : i >= to; i += from <= to ? step : -step) {
+			char number[32];
+			snprintf(number, sizeof(number), "%0*ld", width, i);
+			word_list_add(&alts, strdup(number));
+		}
+	} else if (strlen(body) == 4 && sscanf(body, "%c..%c", &a, &b) == 2 && body[1] == '.') {
+		for (int c = a; a <= b ? c <= b : c >= b; c += a <= b ? 1 : -1) {
+			char letter[2] = {(char)c, '\0'};
+			word_list_add(&alts, strdup(letter));
+		}
+	} else {
+		char *start = body;
+		depth = 0;
+		for (char *q = body;; q++) {
+			if (*q == '{')
+				depth++;
+			else if (*q == '}')
+				depth--;
+			else if ((*q == ',' && depth == 0) || *q == '\0') {
+				word_list_add(&alts, strndup(start, q - start));
+				if (*q == '\0')
+					break;
+				start = q + 1;
+			}
+		}
+	}
+
+	if (alts.count == 0) {
+		word_list_add(out, strdup(word));
+	}
+	for (int i = 0; i < alts.count; i++) {
+		struct strbuf next = {0};
+		strbuf_append(&next, word, open - word);
+		strbuf_puts(&next, alts.words[i]);
+		strbuf_puts(&next, close + 1);
+		expand_braces(next.data, out);
+		free(next.data);
+		free(alts.words[i]);
+	}
+	free(alts.words);
+	free(body);
+}
+
+/**
+ * Expand one token: braces, variables and $(...) output (split on
+ * whitespace) and globs when unquoted, only variables and $(...) inside
+ * "..." and nothing inside '...'
+ * @param out receives the resulting words
+ */
+void expand_word(const char *arg, struct word_list *out) {
+	int len = strlen(arg);
+
+	if (len >= 2 && (arg[0] == '\'' || arg[0] == '"') && arg[len - 1] == arg[0]) {
+		if (arg[0] == '\'') {
+			word_list_add(out, strndup(arg + 1, len - 2));
+			return;
+		}
+		struct strbuf value = {0};
+		strbuf_reserve(&value, len);
+		for (int i = 1; i < len - 1;) {
+			if (arg[i] == '$')
+				i += expand_variable(arg + i, &value);
+			else if (arg[i] == CAPTURE_MARK)
+				i += expand_capture(arg + i, &value);
+			else
+				strbuf_append(&value, arg + i++, 1);
+		}
+		word_list_add(out, value.data);
+		return;
+	}
+
+	struct word_list braced = {0};
+	if (strchr(arg, '{'))
+		expand_braces(arg, &braced);
+	else
+		word_list_add(&braced, strdup(arg));
+
+	for (int b = 0; b < braced.count; b++) {
+		char *word = braced.words[b];
+		struct strbuf value = {0};
+		strbuf_reserve(&value, strlen(word));
+
+		if (strpbrk(word, "$\x1f")) {
+			for (int i = 0; word[i];) {
+				if (word[i] == '$')
+					i += expand_variable(word + i, &value);
+				else if (word[i] == CAPTURE_MARK)
+					i += expand_capture(word + i, &value);
+				else
+					strbuf_append(&value, word + i++, 1);
+			}
+		} else {
+			strbuf_puts(&value, word);
+		}
+
+		// field splitting, empty results vanish
+		char *save;
+		for (char *field = strtok_r(value.data, " \t\n", &save); field;
+			 field = strtok_r(NULL, " \t\n", &save)) {
+			if (!has_glob_chars(field) || !glob_expand(field, out))
+				word_list_add(out, strdup(field));
+		}
+		free(value.data);
+		free(word);
+	}
+	free(braced.words);
+}
+
+//aliases, replacing the first word of each pipeline stage
+struct alias {
+	char *name;
+	char *value;
+	struct alias *next;
+};
+
+#define ALIAS_BUCKETS 256
+struct alias *aliases[ALIAS_BUCKETS];
+int alias_count = 0;
+
+struct alias *alias_find(const char *name, size_t len) {
+	struct alias *a = aliases[hash_bytes(name, len) % ALIAS_BUCKETS];
+	for (; a; a = a->next) {
+		if (strncmp(a->name, name, len) == 0 && a->name[len] == '\0')
+			return a;
+	}
+	return NULL;
+}
+
+void alias_set(const char *name, const char *value) {
+	struct alias *a = alias_find(name, strlen(name));
+	if (a == NULL) {
+		unsigned long bucket = hash_string(name) % ALIAS_BUCKETS;
+		a = calloc(1, sizeof(struct alias));
+		a->name = strdup(name);
+		a->next = aliases[bucket];
+		aliases[bucket] = a;
+		alias_count++;
+	}
+	free(a->value);
+	a->value = strdup(value);
+}
+
+bool alias_remove(const char *name) {
+	struct alias **p = &aliases[hash_string(name) % ALIAS_BUCKETS];
+	for (; *p; p = &(*p)->next) {
+		if (strcmp((*p)->name, name) == 0) {
+			struct alias *a = *p;
+			*p = a->next;
+			free(a->name);
+			free(a->value);
+			free(a);
+			alias_count--;
+			return true;
+		}
+	}
+	return false;
+}
+
+/**
+ * Copy text to out with alias names at the start and after each "|"
+ * replaced. An alias value is expanded again itself, but without the
+ * aliases already used on the way there, so "ls=ls -l" ends.
+ * @return true if an alias applied
+ */
+bool expand_aliases_into(const char *text, struct strbuf *out, struct alias **used, int depth) {
+	bool changed = false;
+	const char *p = text;
+	while (*p) {
+		// p is at the start of a stage
+		size_t space = strspn(p, " \t");
+		strbuf_append(out, p, space);
+		p += space;
+
+		size_t word = strcspn(p, " \t");
+		struct alias *a = depth < 16 ? alias_find(p, word) : NULL;
+		for (int i = 0; a && i < depth; i++) {
+			if (used[i] == a)
+				a = NULL;
+		}
+		if (a != NULL) {
+			used[depth] = a;
+			expand_aliases_into(a->value, out, used, depth + 1);
+			p += word;
+			changed = true;
+		}
+
+		// copy up to the next "|" token
+		while (*p) {
+			size_t len = strcspn(p, " \t");
+			bool pipe = len == 1 && *p == '|';
+			strbuf_append(out, p, len);
+			p += len;
+			space = strspn(p, " \t");
+			strbuf_append(out, p, space);
+			p += space;
+			if (pipe)
+				break;
+		}
+	}
+	return changed;
+}
+
+/**
+ * Expand the aliases of an input line
+ * @return the new line, NULL if no alias applied
+ */
+char *expand_aliases(const char *line) {
+	struct alias *used[16];
+	struct strbuf out = {0};
+	if (alias_count == 0 || !expand_aliases_into(line, &out, used, 0)) {
+		free(out.data);
+		return NULL;
+	}
+	return out.data;
+}
+
 /**
  * Parse a command string into a command struct
  * @param  buf     [description]
@@ -130,20 +788,30 @@ int parse_command(char *buf, struct command_t *command) {
 		command->background = true;
 	}
 
+	// the first token may expand to several words, the rest are arguments
+	struct word_list words = {0};
 	char *pch = strtok(buf, splitters);
-	if (pch == NULL) {
+	if (pch != NULL) {
+		expand_word(pch, &words);
+	}
+	if (words.count == 0) {
 		command->name = (char *)malloc(1);
 		command->name[0] = 0;
 	} else {
-		command->name = (char *)malloc(strlen(pch) + 1);
-		strcpy(command->name, pch);
+		command->name = words.words[0];
 	}
 
-	command->args = (char **)malloc(sizeof(char *));
+	int arg_cap = words.count > 8 ? words.count : 8;
+	command->args = (char **)malloc(sizeof(char *) * arg_cap);
 
 	int redirect_index;
 	int arg_index = 0;
-	char temp_buf[1024], *arg;
+	for (int i = 1; i < words.count; i++) {
+		command->args[arg_index++] = words.words[i];
+	}
+	words.count = 0;
+	// no token can be longer than the line itself (substitutions make it long)
+	char *temp_buf = malloc(len + 1), *arg; // strtok already cut buf short
 
 	while (1) {
 		// tokenize input on splitters
@@ -177,7 +845,7 @@ int parse_command(char *buf, struct command_t *command) {
 
 		// piping to another command
 		if (strcmp(arg, "|") == 0) {
-			struct command_t *c = malloc(sizeof(struct command_t));
+			struct command_t *c = calloc(1, sizeof(struct command_t));
 			int l = strlen(pch);
 			pch[l] = splitters[0]; // restore strtok termination
 			index = 1;
@@ -213,26 +881,32 @@ int parse_command(char *buf, struct command_t *command) {
 		}
 
 		if (redirect_index != -1) {
-			command->redirects[redirect_index] = malloc(len);
-			strcpy(command->redirects[redirect_index], arg + 1);
+			if (len == 1) {
+				// "< file" form, file name is the next token
+				pch = strtok(NULL, splitters);
+				if (!pch)
+					break;
+				command->redirects[redirect_index] = expand_captures(pch);
+				continue;
+			}
+			command->redirects[redirect_index] = expand_captures(arg + 1);
 			continue;
 		}
 
-		// normal arguments
-		if (len > 2 &&
-			((arg[0] == '"' && arg[len - 1] == '"') ||
-			 (arg[0] == '\'' && arg[len - 1] == '\''))) // quote wrapped arg
-		{
-			arg[--len] = 0;
-			arg++;
+		// normal arguments, expanded (quotes are handled there)
+		expand_word(arg, &words);
+		if (arg_index + words.count > arg_cap) {
+			while (arg_index + words.count > arg_cap)
+				arg_cap *= 2; // globs can add hundreds of thousands of args
+			command->args = (char **)realloc(command->args, sizeof(char *) * arg_cap);
 		}
-
-		command->args =
-			(char **)realloc(command->args, sizeof(char *) * (arg_index + 1));
-
-		command->args[arg_index] = (char *)malloc(len + 1);
-		strcpy(command->args[arg_index++], arg);
+		for (int i = 0; i < words.count; i++) {
+			command->args[arg_index++] = words.words[i];
+		}
+		words.count = 0;
 	}
+	free(words.words);
+	free(temp_buf);
 	command->arg_count = arg_index;
 
 	// increase args size by 2
@@ -250,72 +924,458 @@ int parse_command(char *buf, struct command_t *command) {
 	// set args[arg_count-1] (last) to NULL
 	command->args[command->arg_count - 1] = NULL;
 
+	if (strcmp(command->name, "on") == 0)
+		parse_sched_prefix(command);
 	return 0;
 }
 
-void prompt_backspace() {
-	putchar(8); // go back 1
-	putchar(' '); // write empty over
-	putchar(8); // go back 1 again
+void exec_command(struct command_t *command);
+char *expand_substitutions(const char *line);
+
+//process substitutions of the current line, released after it has run
+#define MAX_SUBSTITUTIONS 64
+int subst_count = 0;
+int subst_fds[MAX_SUBSTITUTIONS];
+pid_t subst_pids[MAX_SUBSTITUTIONS];
+
+/**
+ * Run the text of a substitution in the current (forked) process
+ * @param text command line inside the parentheses
+ */
+void run_substitution_child(const char *text) {
+	char *line = expand_substitutions(text);
+	struct command_t *command = calloc(1, sizeof(struct command_t));
+	parse_command(line, command);
+	free(line);
+	exec_command(command);
 }
 
 /**
- * Prompt a command from the user
- * @param  buf      [description]
- * @param  buf_size [description]
- * @return          [description]
+ * Find the parenthesis closing the one opened just before start
+ * @return index of the ')' or 0 if it is missing
  */
-int prompt(struct command_t *command) {
-	size_t index = 0;
-	char c;
-	char buf[4096];
-	static char oldbuf[4096];
+size_t find_closing_paren(const char *line, size_t start) {
+	int depth = 1;
+	char quote = 0;
+	for (size_t i = start; line[i]; i++) {
+		if (quote) {
+			if (line[i] == quote)
+				quote = 0;
+		} else if (line[i] == '\'' || line[i] == '"') {
+			quote = line[i];
+		} else if (line[i] == '(') {
+			depth++;
+		} else if (line[i] == ')' && --depth == 0) {
+			return i;
+		}
+	}
+	return 0;
+}
 
-	// tcgetattr gets the parameters of the current terminal
-	// STDIN_FILENO will tell tcgetattr that it should write the settings
-	// of stdin to oldt
-	static struct termios backup_termios, new_termios;
-	tcgetattr(STDIN_FILENO, &backup_termios);
-	new_termios = backup_termios;
-	// ICANON normally takes care that one line at a time will be processed
-	// that means it will return if it sees a "\n" or an EOF or an EOL
-	new_termios.c_lflag &=
-		~(ICANON |
-		  ECHO); // Also disable automatic echo. We manually echo each char.
-	// Those new settings will be set to STDIN
-	// TCSANOW tells tcsetattr to change attributes immediately.
-	tcsetattr(STDIN_FILENO, TCSANOW, &new_termios);
+/**
+ * $(...): run text with stdout on a pipe and append a marker for its
+ * output to out. The pipe is drained with large reads straight into a
+ * buffer and trailing newlines are dropped.
+ */
+void capture_output(const char *text, struct strbuf *out) {
+	int fds[2];
+	if (pipe(fds) == -1) {
+		perror("pipe");
+		return;
+	}
 
-	show_prompt();
-	buf[0] = 0;
+	fflush(stdout);
+	pid_t pid = fork();
+	if (pid == -1) {
+		perror("fork");
+		close(fds[0]);
+		close(fds[1]);
+		return;
+	}
+	if (pid == 0) {
+		close(fds[0]);
+		dup2(fds[1], STDOUT_FILENO);
+		close(fds[1]);
+		run_substitution_child(text);
+	}
+	close(fds[1]);
 
+	struct strbuf output = {0};
 	while (1) {
-		c = getchar();
-		// printf("Keycode: %u\n", c); // DEBUG: uncomment for debugging
-
-		// handle tab
-		if (c == 9) {
-			buf[index++] = '?'; // autocomplete
+		strbuf_reserve(&output, 65536);
+		ssize_t r = read(fds[0], output.data + output.len, output.cap - output.len - 1);
+		if (r == -1 && errno == EINTR)
+			continue;
+		if (r <= 0)
 			break;
-		}
+		output.len += r;
+	}
+	close(fds[0]);
+	waitpid(pid, NULL, 0);
 
-		// handle backspace
-		if (c == 127) {
-			if (index > 0) {
-				prompt_backspace();
-				index--;
-			}
-			continue;
-		}
+	while (output.len > 0 && output.data[output.len - 1] == '\n')
+		output.len--;
+	output.data[output.len] = '\0';
 
-		if (c == 27 || c == 91 || c == 66 || c == 67 || c == 68) {
-			continue;
-		}
+	if (capture_count == capture_cap) {
+		capture_cap = capture_cap ? capture_cap * 2 : 8;
+		captures = realloc(captures, capture_cap * sizeof(char *));
+	}
+	char mark[32];
+	snprintf(mark, sizeof(mark), "%c%d%c", CAPTURE_MARK, capture_count, CAPTURE_MARK);
+	strbuf_puts(out, mark);
+	captures[capture_count++] = output.data;
+}
 
-		// up arrow
-		if (c == 65) {
-			while (index > 0) {
-				prompt_backspace();
+/**
+ * <(...) and >(...): run text connected to a pipe and append the
+ * /dev/fd/N path of the shell's end, which the command inherits
+ */
+void open_process_substitution(const char *text, bool reading, struct strbuf *out) {
+	if (subst_count == MAX_SUBSTITUTIONS) {
+		fprintf(stderr, "-%s: too many process substitutions\n", sysname);
+		return;
+	}
+
+	int fds[2];
+	if (pipe(fds) == -1) {
+		perror("pipe");
+		return;
+	}
+
+	fflush(stdout);
+	pid_t pid = fork();
+	if (pid == -1) {
+		perror("fork");
+		close(fds[0]);
+		close(fds[1]);
+		return;
+	}
+	if (pid == 0) {
+		if (reading) {
+			close(fds[0]);
+			dup2(fds[1], STDOUT_FILENO);
+			close(fds[1]);
+		} else {
+			close(fds[1]);
+			dup2(fds[0], STDIN_FILENO);
+			close(fds[0]);
+		}
+		run_substitution_child(text);
+	}
+
+	int keep = reading ? fds[0] : fds[1];
+	close(reading ? fds[1] : fds[0]);
+	subst_fds[subst_count] = keep;
+	subst_pids[subst_count++] = pid;
+
+	char path[32];
+	snprintf(path, sizeof(path), "/dev/fd/%d", keep);
+	strbuf_puts(out, path);
+}
+
+/**
+ * Expand $(...) command substitutions and <(...) / >(...) process
+ * substitutions of a line. Everything goes through pipes, no temp files.
+ * @param  line [description]
+ * @return      newly allocated expanded line
+ */
+char *expand_substitutions(const char *line) {
+	struct strbuf out = {0};
+	bool quoted = false; // nothing is substituted inside single quotes
+
+	strbuf_reserve(&out, strlen(line));
+	for (size_t i = 0; line[i]; i++) {
+		char c = line[i];
+		if (c == '\'')
+			quoted = !quoted;
+
+		if (!quoted && (c == '$' || c == '<' || c == '>') && line[i + 1] == '(') {
+			size_t end = find_closing_paren(line, i + 2);
+			if (end != 0) {
+				char *text = strndup(line + i + 2, end - i - 2);
+				if (c == '$')
+					capture_output(text, &out);
+				else
+					open_process_substitution(text, c == '<', &out);
+				free(text);
+				i = end;
+				continue;
+			}
+		}
+		strbuf_append(&out, &c, 1);
+	}
+	return out.data;
+}
+
+/**
+ * Close the shell's ends of the process substitution pipes and reap them,
+ * and drop the captured $(...) output
+ * @param background do not block on the substituted commands
+ */
+void release_substitutions(bool background) {
+	for (int i = 0; i < subst_count; i++)
+		close(subst_fds[i]);
+	for (int i = 0; i < subst_count; i++)
+		waitpid(subst_pids[i], NULL, background ? WNOHANG : 0);
+	subst_count = 0;
+	for (int i = 0; i < capture_count; i++)
+		free(captures[i]);
+	capture_count = 0;
+}
+
+void prompt_backspace() {
+	putchar(8); // go back 1
+	putchar(' '); // write empty over
+	putchar(8); // go back 1 again
+}
+
+/*
+ * Parsed lines, most recently used first. A line that does not depend on
+ * variables, globs, braces or substitutions always parses the same, so
+ * its command is kept with the PATH (and the cwd when a name is looked up
+ * relative to it) it was resolved under and run again without parsing or
+ * searching PATH. Like a shell's hash table, a command installed earlier
+ * in PATH later is not noticed until PATH changes.
+ */
+#define LINE_CACHE_SIZE 64
+#define LINE_CACHE_BUCKETS 128
+
+struct cached_line {
+	char *line;
+	struct command_t *command;
+	char *path_var;
+	char *cwd; // NULL when resolution does not depend on it
+	struct cached_line *prev, *next; // recency list
+	struct cached_line *chain; // hash bucket
+};
+
+struct cached_line *line_cache[LINE_CACHE_BUCKETS];
+struct cached_line *line_cache_head = NULL, *line_cache_tail = NULL;
+int line_cache_count = 0;
+
+bool line_cacheable(const char *line) {
+	return strpbrk(line, "$*?[{(") == NULL;
+}
+
+void line_cache_unlink(struct cached_line *e) {
+	if (e->prev)
+		e->prev->next = e->next;
+	else
+		line_cache_head = e->next;
+	if (e->next)
+		e->next->prev = e->prev;
+	else
+		line_cache_tail = e->prev;
+	e->prev = e->next = NULL;
+}
+
+void line_cache_push_front(struct cached_line *e) {
+	e->next = line_cache_head;
+	if (line_cache_head)
+		line_cache_head->prev = e;
+	line_cache_head = e;
+	if (line_cache_tail == NULL)
+		line_cache_tail = e;
+}
+
+void line_cache_remove(struct cached_line *e) {
+	struct cached_line **p = &line_cache[hash_string(e->line) % LINE_CACHE_BUCKETS];
+	while (*p != e)
+		p = &(*p)->chain;
+	*p = e->chain;
+	line_cache_unlink(e);
+	line_cache_count--;
+
+	e->command->cached = false;
+	free_command(e->command);
+	free(e->line);
+	free(e->path_var);
+	free(e->cwd);
+	free(e);
+}
+
+//true if looking up some stage's name depends on the working directory
+bool resolution_uses_cwd(struct command_t *command, const char *path_var) {
+	for (struct command_t *c = command; c; c = c->next) {
+		if (strchr(c->name, '/') != NULL) {
+			if (c->name[0] != '/')
+				return true;
+			continue;
+		}
+		// empty or relative PATH entries
+		for (const char *dir = path_var; dir; dir = strchr(dir, ':') ? strchr(dir, ':') + 1 : NULL) {
+			if (*dir != '/')
+				return true;
+		}
+	}
+	return false;
+}
+
+/**
+ * The parsed command of a line, if it is cached and still valid
+ * @return NULL when the line has to be parsed
+ */
+struct command_t *line_cache_get(const char *line) {
+	struct cached_line *e = line_cache[hash_string(line) % LINE_CACHE_BUCKETS];
+	while (e && strcmp(e->line, line) != 0)
+		e = e->chain;
+	if (e == NULL)
+		return NULL;
+
+	const char *path_var = getenv("PATH");
+	bool valid = strcmp(e->path_var, path_var ? path_var : "") == 0;
+	if (valid && e->cwd) {
+		char *cwd = getcwd(NULL, 0);
+		valid = cwd && strcmp(cwd, e->cwd) == 0;
+		free(cwd);
+	}
+	if (!valid) {
+		line_cache_remove(e);
+		return NULL;
+	}
+
+	line_cache_unlink(e);
+	line_cache_push_front(e);
+	return e->command;
+}
+
+//keep the command parsed from line, it is not freed after running then
+void line_cache_put(const char *line, struct command_t *command) {
+	if (!line_cacheable(line) || command->name[0] == '\0')
+		return;
+	if (line_cache_count == LINE_CACHE_SIZE)
+		line_cache_remove(line_cache_tail);
+
+	const char *path_var = getenv("PATH");
+	struct cached_line *e = calloc(1, sizeof(struct cached_line));
+	e->line = strdup(line);
+	e->command = command;
+	e->path_var = strdup(path_var ? path_var : "");
+	if (resolution_uses_cwd(command, e->path_var))
+		e->cwd = getcwd(NULL, 0);
+
+	unsigned long bucket = hash_string(line) % LINE_CACHE_BUCKETS;
+	e->chain = line_cache[bucket];
+	line_cache[bucket] = e;
+	line_cache_push_front(e);
+	line_cache_count++;
+	command->cached = true;
+}
+
+/**
+ * Turn an input line into a command: aliases, then the line cache, then
+ * substitutions and parsing
+ */
+void prompt_parse(const char *buf, struct command_t **command) {
+	char *aliased = expand_aliases(buf);
+	const char *text = aliased ? aliased : buf;
+
+	*command = line_cache_get(text);
+	if (*command == NULL) {
+		*command = calloc(1, sizeof(struct command_t));
+		char *line = expand_substitutions(text);
+		parse_command(line, *command);
+		free(line);
+		line_cache_put(text, *command);
+	}
+	free(aliased);
+}
+
+/**
+ * Read a command from a non-terminal stdin (scripts): no prompt, echo or
+ * line editing, and lines are not limited in length
+ * @return SUCCESS or EXIT at end of input
+ */
+int prompt_script(struct command_t **command) {
+	static char *buf = NULL;
+	static size_t cap = 0;
+
+	ssize_t len = getline(&buf, &cap, stdin);
+	if (len == -1) {
+		return EXIT;
+	}
+	if (len > 0 && buf[len - 1] == '\n') {
+		buf[--len] = '\0';
+	}
+
+	// comment lines
+	size_t start = strspn(buf, " \t");
+	if (buf[start] == '#') {
+		buf[start] = '\0';
+	}
+
+	prompt_parse(buf, command);
+	return SUCCESS;
+}
+
+/**
+ * Prompt a command from the user
+ * @param  buf      [description]
+ * @param  buf_size [description]
+ * @return          [description]
+ */
+int prompt(struct command_t **command) {
+	size_t index = 0;
+	int c;
+	char buf[4096];
+	static char oldbuf[4096];
+
+	if (!isatty(STDIN_FILENO)) {
+		return prompt_script(command);
+	}
+
+	// tcgetattr gets the parameters of the current terminal
+	// STDIN_FILENO will tell tcgetattr that it should write the settings
+	// of stdin to oldt
+	static struct termios backup_termios, new_termios;
+	tcgetattr(STDIN_FILENO, &backup_termios);
+	new_termios = backup_termios;
+	// ICANON normally takes care that one line at a time will be processed
+	// that means it will return if it sees a "\n" or an EOF or an EOL
+	new_termios.c_lflag &=
+		~(ICANON |
+		  ECHO); // Also disable automatic echo. We manually echo each char.
+	// Those new settings will be set to STDIN
+	// TCSANOW tells tcsetattr to change attributes immediately.
+	tcsetattr(STDIN_FILENO, TCSANOW, &new_termios);
+
+	show_prompt();
+	buf[0] = 0;
+
+	while (1) {
+		c = getchar();
+		// printf("Keycode: %u\n", c); // DEBUG: uncomment for debugging
+
+		// end of input
+		if (c == EOF) {
+			tcsetattr(STDIN_FILENO, TCSANOW, &backup_termios);
+			return EXIT;
+		}
+
+		// handle tab
+		if (c == 9) {
+			buf[index++] = '?'; // autocomplete
+			break;
+		}
+
+		// handle backspace
+		if (c == 127) {
+			if (index > 0) {
+				prompt_backspace();
+				index--;
+			}
+			continue;
+		}
+
+		if (c == 27 || c == 91 || c == 66 || c == 67 || c == 68) {
+			continue;
+		}
+
+		// up arrow
+		if (c == 65) {
+			while (index > 0) {
+				prompt_backspace();
 				index--;
 			}
 
@@ -348,139 +1408,1290 @@ int prompt(struct command_t *command) {
 
 	strcpy(oldbuf, buf);
 
-	parse_command(buf, command);
+	// restore the old settings, substitutions may run commands
+	tcsetattr(STDIN_FILENO, TCSANOW, &backup_termios);
+
+	prompt_parse(buf, command);
 
-	// print_command(command); // DEBUG: uncomment for debugging
+	// print_command(*command); // DEBUG: uncomment for debugging
 
-	// restore the old settings
-	tcsetattr(STDIN_FILENO, TCSANOW, &backup_termios);
 	return SUCCESS;
 }
 
-int process_command(struct command_t *command);
+/*
+ * Scheduling prefix: "on cpus=0-3 nice=10 ioprio=idle mem=bind:0 -- cmd"
+ * runs one command (or one pipeline stage) pinned and deprioritised. The
+ * settings are applied in the child between fork and exec, so the shell
+ * itself keeps its own. Without a command, "on" applies them to the shell
+ * and everything it launches afterwards.
+ */
+#define IOPRIO_CLASS_SHIFT 13
+#define IOPRIO_WHO_PROCESS 1
+#define MPOL_DEFAULT 0
+#define MPOL_PREFERRED 1
+#define MPOL_BIND 2
+#define MPOL_INTERLEAVE 3
+#define MPOL_LOCAL 4
+
+struct sched_options {
+	bool has_cpus;
+	cpu_set_t cpus;
+	bool has_nice;
+	int nice;
+	int ioprio; // class << 13 | level, -1 when not given
+	int mem_mode; // MPOL_*, -1 when not given
+	unsigned long mem_nodes;
+};
 
-int main() {
-	while (1) {
-		struct command_t *command = malloc(sizeof(struct command_t));
+//settings given to the shell itself, zygote children have to be told
+struct sched_options shell_sched;
+bool shell_sched_set = false;
 
-		// set all bytes to 0
-		memset(command, 0, sizeof(struct command_t));
+void sched_clear(struct sched_options *o) {
+	memset(o, 0, sizeof(*o));
+	o->ioprio = -1;
+	o->mem_mode = -1;
+}
 
-		int code;
-		code = prompt(command);
-		if (code == EXIT) {
-			break;
-		}
+//settings of o that were given override those of into
+void merge_sched(struct sched_options *into, const struct sched_options *o) {
+	if (o->has_cpus) {
+		into->has_cpus = true;
+		into->cpus = o->cpus;
+	}
+	if (o->has_nice) {
+		into->has_nice = true;
+		into->nice = o->nice;
+	}
+	if (o->ioprio != -1)
+		into->ioprio = o->ioprio;
+	if (o->mem_mode != -1) {
+		into->mem_mode = o->mem_mode;
+		into->mem_nodes = o->mem_nodes;
+	}
+}
 
-		code = process_command(command);
-		if (code == EXIT) {
-			break;
+/**
+ * Parse a list such as 0-3,8 into a bit set
+ * @return false if it is malformed or a number is not below limit
+ */
+bool parse_id_list(const char *s, int limit, void (*set)(int id, void *bits), void *bits) {
+	while (*s) {
+		char *end;
+		long from = strtol(s, &end, 10), to = from;
+		if (end == s || from < 0)
+			return false;
+		if (*end == '-') {
+			s = end + 1;
+			to = strtol(s, &end, 10);
+			if (end == s || to < from)
+				return false;
 		}
-
-		free_command(command);
+		if (to >= limit)
+			return false;
+		for (long id = from; id <= to; id++)
+			set(id, bits);
+		if (*end != ',' && *end != '\0')
+			return false;
+		s = *end ? end + 1 : end;
 	}
+	return true;
+}
 
-	printf("\n");
-	return 0;
+void set_cpu(int id, void *bits) {
+	CPU_SET(id, (cpu_set_t *)bits);
 }
 
-int find_executable(struct command_t *command) {
-	char *pathvar = getenv("PATH");
-	char *path = strtok(pathvar, " ");
-	int len = strlen(path);
-	for (int i = 0; i < len; i++) {
-		if (access(path, X_OK) == 0) {
-			command->args[0] = path;
-			return SUCCESS;
-		}
+void set_node(int id, void *bits) {
+	*(unsigned long *)bits |= 1UL << id;
+}
 
-		return UNKNOWN;
+/**
+ * Parse one key=value setting of the "on" prefix
+ * @return false if the key is unknown or the value is invalid
+ */
+bool parse_sched_option(const char *arg, struct sched_options *o) {
+	const char *value = strchr(arg, '=');
+	if (value == NULL)
+		return false;
+	size_t key_len = value++ - arg;
+
+	if (key_len == 4 && strncmp(arg, "cpus", 4) == 0) {
+		CPU_ZERO(&o->cpus);
+		o->has_cpus = parse_id_list(value, CPU_SETSIZE, set_cpu, &o->cpus) &&
+					  CPU_COUNT(&o->cpus) > 0;
+		return o->has_cpus;
 	}
-	return UNKNOWN;
-
+	if (key_len == 4 && strncmp(arg, "nice", 4) == 0) {
+		char *end;
+		long n = strtol(value, &end, 10);
+		if (end == value || *end || n < -20 || n > 19)
+			return false;
+		o->has_nice = true;
+		o->nice = n;
+		return true;
+	}
+	if (key_len == 6 && strncmp(arg, "ioprio", 6) == 0) {
+		// idle, be[:0-7] or rt[:0-7]
+		int class, level = 4;
+		if (strcmp(value, "idle") == 0) {
+			o->ioprio = 3 << IOPRIO_CLASS_SHIFT;
+			return true;
+		}
+		if (strncmp(value, "be", 2) == 0)
+			class = 2;
+		else if (strncmp(value, "rt", 2) == 0)
+			class = 1;
+		else
+			return false;
+		if (value[2] == ':' && value[3] >= '0' && value[3] <= '7' && value[4] == '\0')
+			level = value[3] - '0';
+		else if (value[2] != '\0')
+			return false;
+		o->ioprio = class << IOPRIO_CLASS_SHIFT | level;
+		return true;
+	}
+	if (key_len == 3 && strncmp(arg, "mem", 3) == 0) {
+		// local, or bind/interleave/preferred with a node list
+		const char *modes[] = {"default", "preferred", "bind", "interleave", "local"};
+		const char *nodes = strchr(value, ':');
+		size_t len = nodes ? (size_t)(nodes - value) : strlen(value);
+		for (int mode = 0; mode < 5; mode++) {
+			if (strlen(modes[mode]) != len || strncmp(value, modes[mode], len) != 0)
+				continue;
+			o->mem_mode = mode;
+			o->mem_nodes = 0;
+			if (mode == MPOL_DEFAULT || mode == MPOL_LOCAL)
+				return nodes == NULL;
+			return nodes != NULL &&
+				   parse_id_list(nodes + 1, sizeof(unsigned long) * 8, set_node, &o->mem_nodes) &&
+				   o->mem_nodes != 0;
+		}
+		return false;
+	}
+	return false;
 }
 
-int roll(char *input) {
+/**
+ * Parse the settings in args[1...], up to "--" or the first word that is
+ * not a setting
+ * @return index of the first word of the command, -1 on an invalid setting
+ *         (reported unless quiet)
+ */
+int parse_sched_args(char **args, struct sched_options *o, bool quiet) {
+	sched_clear(o);
+
+	int i = 1;
+	for (; args[i]; i++) {
+		if (strcmp(args[i], "--") == 0)
+			return i + 1;
+		if (strchr(args[i], '=') == NULL)
+			break;
+		if (!parse_sched_option(args[i], o)) {
+			if (!quiet)
+				fprintf(stderr, "-%s: on: %s: invalid setting\n", sysname, args[i]);
+			return -1;
+		}
+	}
+	return i;
+}
 
-	int number_of_rolls=0, lower=0, upper=0, sum=0;
-	if (strlen(input) == 2 && input[0] == 'd' && isdigit(input[1])) {
-		lower=1, upper=atoi(&input[1]), number_of_rolls=1;
-	} else if (strlen(input) == 3 && input[1] == 'd' && isdigit(input[0]) && isdigit(input[2])) {
-		lower=1, upper=atoi(&input[2]), number_of_rolls=atoi(&input[0]);
-	} else {
-		printf("Invalid input\n");
-		return EXIT;
+/**
+ * Apply the settings to the calling process
+ * @return 0, -1 with a message printed if one could not be applied
+ */
+int apply_sched(const struct sched_options *o) {
+	const char *what = NULL;
+	if (o->has_cpus && sched_setaffinity(0, sizeof(o->cpus), &o->cpus) == -1)
+		what = "cpus";
+	else if (o->has_nice && setpriority(PRIO_PROCESS, 0, o->nice) == -1)
+		what = "nice";
+	else if (o->ioprio != -1 &&
+			 syscall(SYS_ioprio_set, IOPRIO_WHO_PROCESS, 0, o->ioprio) == -1)
+		what = "ioprio";
+	else if (o->mem_mode != -1 &&
+			 syscall(SYS_set_mempolicy, o->mem_mode, o->mem_nodes ? &o->mem_nodes : NULL,
+					 o->mem_nodes ? sizeof(unsigned long) * 8 + 1 : 0) == -1)
+		what = "mem";
+
+	if (what) {
+		fprintf(stderr, "-%s: on: %s: %s\n", sysname, what, strerror(errno));
+		return -1;
 	}
+	return 0;
+}
+
+/**
+ * Move an "on" prefix of a parsed command into command->sched. Left as
+ * is when a setting is invalid or no command follows, the "on" builtin
+ * then reports the error or applies the settings to the shell.
+ */
+void parse_sched_prefix(struct command_t *command) {
+	struct sched_options o;
+	int start = parse_sched_args(command->args, &o, true);
+	if (start == -1 || command->args[start] == NULL)
+		return;
 
-	int *faces = malloc(number_of_rolls * sizeof(int));
+	command->sched = malloc(sizeof(struct sched_options));
+	*command->sched = o;
+	for (int i = 0; i < start; i++)
+		free(command->args[i]);
+	memmove(command->args, command->args + start,
+			(command->arg_count - start) * sizeof(char *));
+	command->arg_count -= start;
+	free(command->name);
+	command->name = strdup(command->args[0]);
+}
 
-	for (int i = 0 ; i < number_of_rolls ; i++) {
-		int face = (rand() % (upper - lower + 1)) + lower;
-		faces[i] = face;
-		sum += face;
+//on settings [-- command], the form without a command
+int on(struct command_t *command) {
+	struct sched_options o;
+	int start = parse_sched_args(command->args, &o, false);
+	if (start == -1)
+		return 2;
+	if (command->args[start] != NULL)
+		return 0; // a command follows, parse_command took the settings
+	if (apply_sched(&o) == -1)
+		return 1;
+	if (!shell_sched_set) {
+		sched_clear(&shell_sched);
+		shell_sched_set = true;
 	}
+	merge_sched(&shell_sched, &o);
+	return 0;
+}
 
-	char pattern[1024] = {'\0'};
+/*
+ * Zygote: a small launcher process forked at startup, before the shell
+ * grows, that forks and execs external commands on request. Forking from
+ * its tiny image keeps spawn latency low and flat however much memory the
+ * shell has accumulated. Enabled with MISHELL_ZYGOTE=1.
+ *
+ * The shell sends a zygote_request and a payload of NUL separated strings
+ * (path, cwd, argv, environ) over a Unix socket, with the command's
+ * stdin/stdout/stderr attached as SCM_RIGHTS. The zygote answers with a
+ * ZYGOTE_SPAWNED reply, and a ZYGOTE_EXITED reply once the process ends.
+ */
+int zygote_fd = -1;
+pid_t zygote_owner = -1; // forked children of the shell must not use it
+
+struct zygote_request {
+	size_t length; // of the payload
+	int argc;
+	int envc;
+	bool has_sched;
+	struct sched_options sched; // applied by the child before exec
+};
 
-	if ((strlen(input) == 2)) {
-		printf("Rolled %d\n", sum);
-	} else {
-		for (int i = 0; i < number_of_rolls; i++) {
-			char num_str[10];
-			sprintf(num_str, "%d", faces[i]);
-
-			if (i == 0) {
-				strcat(pattern, "(");
-				strcat(pattern, num_str);
-				strcat(pattern, " + ");
-			} else if (i == number_of_rolls - 1) {
-				strcat(pattern, num_str);
-				strcat(pattern, ")");
-			} else {
-				strcat(pattern, num_str);
-				strcat(pattern, " + ");
-			}
-		}
-		printf("Rolled %d %s\n", sum, pattern);
-	}
+#define ZYGOTE_SPAWNED 0
+#define ZYGOTE_EXITED 1
+struct zygote_reply {
+	int kind;
+	pid_t pid; // -1 if the fork failed
+	int status; // wait status for ZYGOTE_EXITED
+};
 
-	free(faces);
+//exits that arrived while waiting for something else, grown as needed
+struct zygote_reply *zygote_pending = NULL;
+int zygote_pending_count = 0;
+int zygote_pending_cap = 0;
 
-	return SUCCESS;
+extern char **environ;
 
+int read_full(int fd, void *buf, size_t len) {
+	for (size_t done = 0; done < len;) {
+		ssize_t n = read(fd, (char *)buf + done, len - done);
+		if (n == -1 && errno == EINTR)
+			continue;
+		if (n <= 0)
+			return -1;
+		done += n;
+	}
+	return 0;
 }
 
-//cdh part write to file from cd
-void writefile(char* directory) {
-	char *homedir = getenv("HOME");
-	char path[1024];
-	char path2[1024];
-	if (homedir == NULL) {
-		fprintf(stderr, "Error: no HOME env");
-		return;
+int write_full(int fd, const void *buf, size_t len) {
+	for (size_t done = 0; done < len;) {
+		ssize_t n = write(fd, (const char *)buf + done, len - done);
+		if (n == -1 && errno == EINTR)
+			continue;
+		if (n <= 0)
+			return -1;
+		done += n;
 	}
-	snprintf(path, sizeof(path), "%s/%s", homedir, "cdh_history.txt");
+	return 0;
+}
 
-	FILE *fp = fopen(path, "r+");
-	if (fp == NULL) {
-		// Try creating the file instead
-		fp = fopen(path, "w");
+/**
+ * Receive a request header and its three descriptors
+ * @return -1 when the shell went away
+ */
+int zygote_receive(int fd, struct zygote_request *request, int fds[3]) {
+	union {
+		char buf[CMSG_SPACE(3 * sizeof(int))];
+		struct cmsghdr align;
+	} control;
+	struct iovec iov = {request, sizeof(*request)};
+	struct msghdr msg = {0};
+	msg.msg_iov = &iov;
+	msg.msg_iovlen = 1;
+	msg.msg_control = control.buf;
+	msg.msg_controllen = sizeof(control.buf);
+
+	ssize_t n;
+	do {
+		n = recvmsg(fd, &msg, 0);
+	} while (n == -1 && errno == EINTR);
+	if (n <= 0)
+		return -1;
+
+	struct cmsghdr *cmsg = CMSG_FIRSTHDR(&msg);
+	if (cmsg == NULL || cmsg->cmsg_type != SCM_RIGHTS)
+		return -1;
+	memcpy(fds, CMSG_DATA(cmsg), 3 * sizeof(int));
+
+	// a stream socket may split the header
+	if ((size_t)n < sizeof(*request))
+		return read_full(fd, (char *)request + n, sizeof(*request) - n);
+	return 0;
+}
 
-		if (fp == NULL) {
-			fprintf(stderr, "Cannot create or open file for appending: %s\n", strerror(errno));
-			return;
+/**
+ * Body of the zygote process, never returns
+ */
+void zygote_serve(int fd) {
+	sigset_t mask, old_mask;
+	sigemptyset(&mask);
+	sigaddset(&mask, SIGCHLD);
+	sigprocmask(SIG_BLOCK, &mask, &old_mask);
+	int sfd = signalfd(-1, &mask, SFD_CLOEXEC);
+
+	struct pollfd pfds[2] = {{fd, POLLIN, 0}, {sfd, POLLIN, 0}};
+	while (1) {
+		if (poll(pfds, 2, -1) == -1) {
+			if (errno == EINTR)
+				continue;
+			_exit(1);
 		}
 
-		fprintf(fp, "%s", directory);
+		if (pfds[1].revents & POLLIN) {
+			struct signalfd_siginfo info;
+			struct zygote_reply reply = {ZYGOTE_EXITED, 0, 0};
+			read(sfd, &info, sizeof(info));
+			while ((reply.pid = waitpid(-1, &reply.status, WNOHANG)) > 0)
+				write_full(fd, &reply, sizeof(reply));
+		}
 
-	} else {
-		snprintf(path2, sizeof(path2), "%s/%s", homedir, "temp.txt");
-		FILE *temp = fopen(path2, "w");
-		fprintf(temp, "%s\n", directory);
+		if (!(pfds[0].revents & (POLLIN | POLLHUP)))
+			continue;
 
-		char line[256];
-		while (fgets(line, sizeof(line), fp) != NULL) {
-			fprintf(temp, "%s\n", line);
+		struct zygote_request request;
+		int fds[3];
+		if (zygote_receive(fd, &request, fds) == -1)
+			_exit(0); // the shell exited
+		char *payload = malloc(request.length);
+		if (read_full(fd, payload, request.length) == -1)
+			_exit(0);
+
+		// path, cwd, argv..., environ...
+		char **strings = malloc((request.argc + request.envc + 4) * sizeof(char *));
+		char *p = payload;
+		for (int i = 0; i < 2 + request.argc + request.envc; i++) {
+			strings[i] = p;
+			p += strlen(p) + 1;
+		}
+		char **argv = strings + 2;
+		char **envp = argv + request.argc + 1;
+		memmove(envp, argv + request.argc, request.envc * sizeof(char *));
+		argv[request.argc] = NULL;
+		envp[request.envc] = NULL;
+
+		struct zygote_reply reply = {ZYGOTE_SPAWNED, fork(), 0};
+		if (reply.pid == 0) {
+			sigprocmask(SIG_SETMASK, &old_mask, NULL);
+			close(fd);
+			close(sfd);
+			for (int i = 0; i < 3; i++)
+				dup2(fds[i], i);
+			for (int i = 0; i < 3; i++) {
+				if (fds[i] > 2)
+					close(fds[i]);
+			}
+			if (chdir(strings[1]) == -1) {
+				fprintf(stderr, "-%s: %s: %s\n", sysname, strings[1], strerror(errno));
+			}
+			if (request.has_sched && apply_sched(&request.sched) == -1)
+				_exit(1);
+			execve(strings[0], argv, envp);
+			fprintf(stderr, "-%s: %s: %s\n", sysname, argv[0], strerror(errno));
+			_exit(126);
+		}
+		for (int i = 0; i < 3; i++)
+			close(fds[i]);
+		free(strings);
+		free(payload);
+		write_full(fd, &reply, sizeof(reply));
+	}
+}
+
+/**
+ * Fork the zygote, called first thing in main() while the shell is small
+ */
+void zygote_start() {
+	int sv[2];
+	if (socketpair(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0, sv) == -1) {
+		perror("socketpair");
+		return;
+	}
+
+	pid_t pid = fork();
+	if (pid == -1) {
+		perror("fork");
+		close(sv[0]);
+		close(sv[1]);
+		return;
+	}
+	if (pid == 0) {
+		close(sv[0]);
+		zygote_serve(sv[1]);
+	}
+	close(sv[1]);
+	zygote_fd = sv[0];
+	zygote_owner = getpid();
+}
+
+bool zygote_available() {
+	return zygote_fd != -1 && zygote_owner == getpid();
+}
+
+void zygote_stop() {
+	fprintf(stderr, "-%s: zygote: %s, launching directly\n", sysname, strerror(errno));
+	close(zygote_fd);
+	zygote_fd = -1;
+}
+
+void zygote_stash(struct zygote_reply *reply) {
+	if (zygote_pending_count == zygote_pending_cap) {
+		zygote_pending_cap = zygote_pending_cap ? zygote_pending_cap * 2 : 64;
+		zygote_pending = realloc(zygote_pending,
+								 zygote_pending_cap * sizeof(struct zygote_reply));
+	}
+	zygote_pending[zygote_pending_count++] = *reply;
+}
+
+/**
+ * Launch a resolved command through the zygote
+ * @param  path resolved executable
+ * @param  fds  stdin, stdout and stderr of the command
+ * @param  sched settings of an "on" prefix, or NULL
+ * @return      pid of the command, -1 if the zygote is not usable
+ */
+pid_t zygote_spawn(const char *path, char **argv, int fds[3],
+				   const struct sched_options *sched) {
+	struct strbuf payload = {0};
+	struct zygote_request request = {0};
+	fflush(stdout); // what the shell printed so far comes first
+	if (shell_sched_set || sched) {
+		// the zygote did not inherit what "on" set for the shell
+		request.has_sched = true;
+		if (shell_sched_set)
+			request.sched = shell_sched;
+		else
+			sched_clear(&request.sched);
+		if (sched)
+			merge_sched(&request.sched, sched);
+	}
+	char *cwd = getcwd(NULL, 0);
+
+	strbuf_append(&payload, path, strlen(path) + 1);
+	strbuf_append(&payload, cwd ? cwd : "/", strlen(cwd ? cwd : "/") + 1);
+	free(cwd);
+	for (; argv[request.argc]; request.argc++)
+		strbuf_append(&payload, argv[request.argc], strlen(argv[request.argc]) + 1);
+	for (; environ[request.envc]; request.envc++)
+		strbuf_append(&payload, environ[request.envc], strlen(environ[request.envc]) + 1);
+	request.length = payload.len;
+
+	union {
+		char buf[CMSG_SPACE(3 * sizeof(int))];
+		struct cmsghdr align;
+	} control;
+	memset(&control, 0, sizeof(control));
+	struct iovec iov = {&request, sizeof(request)};
+	struct msghdr msg = {0};
+	msg.msg_iov = &iov;
+	msg.msg_iovlen = 1;
+	msg.msg_control = control.buf;
+	msg.msg_controllen = sizeof(control.buf);
+	struct cmsghdr *cmsg = CMSG_FIRSTHDR(&msg);
+	cmsg->cmsg_level = SOL_SOCKET;
+	cmsg->cmsg_type = SCM_RIGHTS;
+	cmsg->cmsg_len = CMSG_LEN(3 * sizeof(int));
+	memcpy(CMSG_DATA(cmsg), fds, 3 * sizeof(int));
+
+	ssize_t n;
+	do {
+		n = sendmsg(zygote_fd, &msg, MSG_NOSIGNAL);
+	} while (n == -1 && errno == EINTR);
+	if (n != sizeof(request) || write_full(zygote_fd, payload.data, payload.len) == -1) {
+		free(payload.data);
+		zygote_stop();
+		return -1;
+	}
+	free(payload.data);
+
+	struct zygote_reply reply;
+	while (1) {
+		if (read_full(zygote_fd, &reply, sizeof(reply)) == -1) {
+			zygote_stop();
+			return -1;
+		}
+		if (reply.kind == ZYGOTE_SPAWNED)
+			return reply.pid;
+		zygote_stash(&reply);
+	}
+}
+
+/**
+ * Wait for a command launched by the zygote
+ * @return its wait status, or -1 if it is unknown
+ */
+int zygote_wait(pid_t pid) {
+	for (int i = 0; i < zygote_pending_count; i++) {
+		if (zygote_pending[i].pid == pid) {
+			int status = zygote_pending[i].status;
+			zygote_pending[i] = zygote_pending[--zygote_pending_count];
+			return status;
+		}
+	}
+
+	struct zygote_reply reply;
+	while (zygote_fd != -1) {
+		if (read_full(zygote_fd, &reply, sizeof(reply)) == -1) {
+			zygote_stop();
+			break;
+		}
+		if (reply.kind == ZYGOTE_EXITED && reply.pid == pid)
+			return reply.status;
+		zygote_stash(&reply);
+	}
+	return -1;
+}
+
+//drop the exits of background commands so the socket never fills up
+void zygote_reap() {
+	struct pollfd pfd = {zygote_fd, POLLIN, 0};
+	struct zygote_reply reply;
+
+	while (zygote_fd != -1 && poll(&pfd, 1, 0) == 1) {
+		if (read_full(zygote_fd, &reply, sizeof(reply)) == -1) {
+			zygote_stop();
+			break;
+		}
+	}
+	zygote_pending_count = 0;
+}
+
+/*
+ * Startup file, ~/.mishellrc or $MISHELL_RC. Lines are "export NAME=value"
+ * and "alias name=value"; builtins are configured through their MISHELL_*
+ * variables. The parsed lines are kept in a binary snapshot next to the rc
+ * file and reused as long as its inode, size and mtime do not change, so
+ * startup reads one file and tokenizes nothing. Values are stored as
+ * written and variables in them are expanded at every load.
+ */
+#define RC_SNAPSHOT_MAGIC 0x31435268534d694dULL // "MiMShRC1"
+
+#define RC_EXPORT 'e'
+#define RC_EXPORT_LITERAL 'l' // single quoted, no expansion
+#define RC_ALIAS 'a'
+
+struct rc_snapshot_header {
+	uint64_t magic;
+	uint64_t dev;
+	uint64_t ino;
+	int64_t size;
+	int64_t mtime_sec;
+	int64_t mtime_nsec;
+	uint32_t length; // of the records following the header
+};
+
+//remove matching quotes around a value
+char *rc_unquote(char *value, char *quote) {
+	size_t len = strlen(value);
+	*quote = 0;
+	if (len >= 2 && (value[0] == '\'' || value[0] == '"') && value[len - 1] == value[0]) {
+		*quote = value[0];
+		value[len - 1] = '\0';
+		return value + 1;
+	}
+	return value;
+}
+
+/**
+ * Turn one rc line into a record: kind, name, NUL, value, NUL
+ * @return false if the line is not understood
+ */
+bool rc_compile_line(char *line, struct strbuf *records) {
+	char *kind = line + strspn(line, " \t");
+	size_t kind_len = strcspn(kind, " \t");
+	char *name = kind + kind_len + strspn(kind + kind_len, " \t");
+	char *eq = strchr(name, '=');
+	if (eq == NULL || eq == name || strcspn(name, " \t") < (size_t)(eq - name))
+		return false;
+	*eq = '\0';
+
+	char quote, record;
+	char *value = rc_unquote(eq + 1, &quote);
+	if (kind_len == 6 && strncmp(kind, "export", 6) == 0)
+		record = quote == '\'' ? RC_EXPORT_LITERAL : RC_EXPORT;
+	else if (kind_len == 5 && strncmp(kind, "alias", 5) == 0)
+		record = RC_ALIAS;
+	else
+		return false;
+
+	strbuf_append(records, &record, 1);
+	strbuf_append(records, name, strlen(name) + 1);
+	strbuf_append(records, value, strlen(value) + 1);
+	return true;
+}
+
+/*
+ * The environment while the rc file is applied. setenv() searches and
+ * copies environ on every call, quadratic over a large rc file, so the
+ * array is built here with a name index and environ pointed at it.
+ */
+struct env_table {
+	char **vars;
+	int count;
+	int cap;
+	int *index; // position in vars + 1, 0 for an empty slot
+	size_t index_cap;
+};
+
+int *env_slot(struct env_table *t, const char *name, size_t len) {
+	size_t i = hash_bytes(name, len) & (t->index_cap - 1);
+	while (t->index[i]) {
+		const char *var = t->vars[t->index[i] - 1];
+		if (strncmp(var, name, len) == 0 && var[len] == '=')
+			break;
+		i = (i + 1) & (t->index_cap - 1);
+	}
+	return &t->index[i];
+}
+
+void env_set(struct env_table *t, const char *name, const char *value) {
+	if (t->count + 2 > t->cap || 2 * (t->count + 1) > (int)t->index_cap) {
+		int n = 0;
+		while (environ[n])
+			n++;
+		t->cap = 2 * (n + 16);
+		char **vars = malloc(t->cap * sizeof(char *));
+		memcpy(vars, environ, (n + 1) * sizeof(char *));
+		free(t->vars); // environ is vars here, it was copied above
+		t->vars = vars;
+		t->count = n;
+		free(t->index);
+		for (t->index_cap = 64; t->index_cap < 2 * (size_t)t->cap; t->index_cap *= 2)
+			;
+		t->index = calloc(t->index_cap, sizeof(int));
+		for (int i = 0; i < n; i++) {
+			const char *var = vars[i];
+			int *slot = env_slot(t, var, strcspn(var, "="));
+			if (*slot == 0)
+				*slot = i + 1;
+		}
+		environ = vars;
+	}
+
+	size_t name_len = strlen(name), value_len = strlen(value);
+	char *var = malloc(name_len + value_len + 2);
+	memcpy(var, name, name_len);
+	var[name_len] = '=';
+	memcpy(var + name_len + 1, value, value_len + 1);
+
+	int *slot = env_slot(t, name, name_len);
+	if (*slot) {
+		t->vars[*slot - 1] = var; // the old string may still be referenced
+	} else {
+		t->vars[t->count] = var;
+		t->vars[++t->count] = NULL;
+		*slot = t->count;
+	}
+}
+
+/**
+ * Split the record at p into its name and value
+ * @return the next record, NULL if this one runs past end
+ */
+const char *rc_record_next(const char *p, const char *end, const char **name,
+						   const char **value) {
+	*name = p + 1;
+	const char *nul = *name < end ? memchr(*name, '\0', end - *name) : NULL;
+	if (nul == NULL || nul + 1 >= end)
+		return NULL;
+	*value = nul + 1;
+	nul = memchr(*value, '\0', end - *value);
+	return nul ? nul + 1 : NULL;
+}
+
+//apply the records, whether they were just compiled or read back
+void rc_apply(const char *records, size_t length) {
+	struct env_table env = {0};
+	const char *p = records, *end = records + length;
+	while (p < end) {
+		char kind = *p;
+		const char *name, *value;
+		p = rc_record_next(p, end, &name, &value);
+		if (p == NULL)
+			break; // cut short, nothing after it can be trusted
+
+		if (kind == RC_ALIAS) {
+			alias_set(name, value);
+		} else if (kind == RC_EXPORT_LITERAL) {
+			env_set(&env, name, value);
+		} else if (kind == RC_EXPORT) {
+			struct strbuf expanded = {0};
+			strbuf_reserve(&expanded, strlen(value));
+			for (int i = 0; value[i];) {
+				if (value[i] == '$')
+					i += expand_variable(value + i, &expanded);
+				else
+					strbuf_append(&expanded, value + i++, 1);
+			}
+			env_set(&env, name, expanded.data);
+			free(expanded.data);
+		}
+	}
+	free(env.index); // env.vars stays, it is environ now
+}
+
+//the snapshot's records if it was made from this version of the rc file
+char *rc_read_snapshot(const char *path, const struct stat *rc, size_t *length) {
+	struct rc_snapshot_header header;
+	int fd = open(path, O_RDONLY | O_CLOEXEC);
+	if (fd == -1)
+		return NULL;
+
+	char *records = NULL;
+	if (read_full(fd, &header, sizeof(header)) == 0 && header.magic == RC_SNAPSHOT_MAGIC &&
+		header.dev == (uint64_t)rc->st_dev && header.ino == (uint64_t)rc->st_ino &&
+		header.size == rc->st_size && header.mtime_sec == rc->st_mtim.tv_sec &&
+		header.mtime_nsec == rc->st_mtim.tv_nsec) {
+		records = malloc((size_t)header.length + 1);
+		bool valid = records != NULL && read_full(fd, records, header.length) == 0;
+		if (valid) {
+			// every record must be whole, or the rc file is compiled again
+			records[header.length] = '\0';
+			const char *p = records, *end = records + header.length, *name, *value;
+			while (p != NULL && p < end)
+				p = rc_record_next(p, end, &name, &value);
+			valid = p != NULL;
+		}
+		if (valid) {
+			*length = header.length;
+		} else {
+			free(records);
+			records = NULL;
+		}
+	}
+	close(fd);
+	return records;
+}
+
+void rc_write_snapshot(const char *path, const struct stat *rc, const struct strbuf *records) {
+	struct rc_snapshot_header header = {RC_SNAPSHOT_MAGIC, rc->st_dev, rc->st_ino, rc->st_size,
+										rc->st_mtim.tv_sec, rc->st_mtim.tv_nsec, records->len};
+	char tmp[PATH_MAX + 32];
+	snprintf(tmp, sizeof(tmp), "%s.%d", path, (int)getpid());
+	int fd = open(tmp, O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0600);
+	if (fd == -1)
+		return; // read-only location, parse again next time
+	if (write_full(fd, &header, sizeof(header)) == 0 &&
+		write_full(fd, records->data, records->len) == 0 && close(fd) == 0) {
+		rename(tmp, path);
+	} else {
+		unlink(tmp);
+	}
+}
+
+void load_rc() {
+	char rc_path[PATH_MAX], snapshot_path[PATH_MAX + 16];
+	const char *env = getenv("MISHELL_RC");
+	if (env) {
+		if (*env == '\0')
+			return; // MISHELL_RC= disables it
+		snprintf(rc_path, sizeof(rc_path), "%s", env);
+	} else {
+		if (getenv("HOME") == NULL)
+			return;
+		snprintf(rc_path, sizeof(rc_path), "%s/.mishellrc", getenv("HOME"));
+	}
+	snprintf(snapshot_path, sizeof(snapshot_path), "%s.snapshot", rc_path);
+
+	struct stat st;
+	if (stat(rc_path, &st) == -1)
+		return;
+
+	size_t length;
+	char *records = rc_read_snapshot(snapshot_path, &st, &length);
+	if (records != NULL) {
+		rc_apply(records, length);
+		free(records);
+		return;
+	}
+
+	FILE *fp = fopen(rc_path, "r");
+	if (fp == NULL)
+		return;
+	struct strbuf compiled = {0};
+	char *line = NULL;
+	size_t cap = 0;
+	ssize_t len;
+	for (int number = 1; (len = getline(&line, &cap, fp)) != -1; number++) {
+		if (len > 0 && line[len - 1] == '\n')
+			line[--len] = '\0';
+		size_t start = strspn(line, " \t");
+		if (line[start] == '\0' || line[start] == '#')
+			continue;
+		if (!rc_compile_line(line, &compiled))
+			fprintf(stderr, "-%s: %s:%d: ignored\n", sysname, rc_path, number);
+	}
+	free(line);
+	fclose(fp);
+
+	if (compiled.len > 0)
+		rc_apply(compiled.data, compiled.len);
+	rc_write_snapshot(snapshot_path, &st, &compiled);
+	free(compiled.data);
+}
+
+int main() {
+	// the rc file may set MISHELL_ZYGOTE, it is small enough to load first
+	load_rc();
+
+	// before anything else is loaded, the zygote must stay small
+	if (getenv("MISHELL_ZYGOTE") && strcmp(getenv("MISHELL_ZYGOTE"), "1") == 0) {
+		zygote_start();
+	}
+
+	while (1) {
+		// reap finished background jobs
+		while (waitpid(-1, NULL, WNOHANG) > 0)
+			;
+		if (zygote_fd != -1) {
+			zygote_reap();
+		}
+
+		struct command_t *command = NULL;
+
+		int code;
+		code = prompt(&command);
+		if (code == EXIT) {
+			break;
+		}
+
+		code = process_command(command);
+		release_substitutions(command->background);
+		dircache_clear();
+		if (code == EXIT) {
+			break;
+		}
+
+		if (!command->cached) {
+			free_command(command);
+		}
+	}
+
+	if (isatty(STDIN_FILENO)) {
+		printf("\n");
+	}
+	return 0;
+}
+
+/**
+ * Resolve the command name over PATH and store the full path in args[0]
+ * @param  command [description]
+ * @return         SUCCESS or UNKNOWN if there is no such executable
+ */
+int find_executable(struct command_t *command) {
+	char candidate[PATH_MAX];
+	struct stat st;
+
+	// a cached command found before, still there
+	if (command->resolved && access(command->args[0], X_OK) == 0)
+		return SUCCESS;
+
+	if (strchr(command->name, '/') != NULL) {
+		if (access(command->name, X_OK) != 0)
+			return UNKNOWN;
+		free(command->args[0]);
+		command->args[0] = strdup(command->name);
+		command->resolved = true;
+		return SUCCESS;
+	}
+
+	const char *pathvar = getenv("PATH");
+	if (pathvar == NULL || command->name[0] == '\0')
+		return UNKNOWN;
+
+	// walk the colon separated list without touching the environment
+	const char *dir = pathvar;
+	while (1) {
+		const char *end = strchr(dir, ':');
+		int len = end ? (int)(end - dir) : (int)strlen(dir);
+		if (len == 0)
+			snprintf(candidate, sizeof(candidate), "%s", command->name);
+		else
+			snprintf(candidate, sizeof(candidate), "%.*s/%s", len, dir, command->name);
+
+		if (access(candidate, X_OK) == 0 && stat(candidate, &st) == 0 && S_ISREG(st.st_mode)) {
+			free(command->args[0]);
+			command->args[0] = strdup(candidate);
+			command->resolved = true;
+			return SUCCESS;
+		}
+		if (end == NULL)
+			break;
+		dir = end + 1;
+	}
+	return UNKNOWN;
+}
+
+/*
+ * xoshiro256** random generator. The state is kept as four independent
+ * lanes laid out word-major, so rng_fill() runs the lanes side by side
+ * and the compiler can vectorize it.
+ */
+#define RNG_LANES 4
+struct rng_state {
+	uint64_t s[4][RNG_LANES];
+	bool seeded;
+};
+struct rng_state rng;
+
+static inline uint64_t rotl64(uint64_t x, int k) {
+	return (x << k) | (x >> (64 - k));
+}
+
+uint64_t splitmix64(uint64_t *x) {
+	uint64_t z = (*x += 0x9e3779b97f4a7c15ULL);
+	z = (z ^ (z >> 30)) * 0xbf58476d1ce4e5b9ULL;
+	z = (z ^ (z >> 27)) * 0x94d049bb133111ebULL;
+	return z ^ (z >> 31);
+}
+
+void rng_seed(uint64_t seed) {
+	for (int l = 0; l < RNG_LANES; l++) {
+		for (int w = 0; w < 4; w++)
+			rng.s[w][l] = splitmix64(&seed);
+	}
+	rng.seeded = true;
+}
+
+//seed from the clock and pid the first time the generator is used
+void rng_init() {
+	if (!rng.seeded) {
+		struct timespec ts;
+		clock_gettime(CLOCK_REALTIME, &ts);
+		rng_seed((uint64_t)ts.tv_sec * 1000000007ULL ^ (uint64_t)ts.tv_nsec ^
+				 ((uint64_t)getpid() << 32));
+	}
+}
+
+//one number from lane 0
+uint64_t rng_next() {
+	uint64_t (*s)[RNG_LANES] = rng.s;
+	uint64_t result = rotl64(s[1][0] * 5, 7) * 9;
+	uint64_t t = s[1][0] << 17;
+	s[2][0] ^= s[0][0];
+	s[3][0] ^= s[1][0];
+	s[1][0] ^= s[2][0];
+	s[0][0] ^= s[3][0];
+	s[2][0] ^= t;
+	s[3][0] = rotl64(s[3][0], 45);
+	return result;
+}
+
+//bulk generation, all lanes step together
+void rng_fill(uint64_t *out, size_t n) {
+	uint64_t (*s)[RNG_LANES] = rng.s;
+	size_t i = 0;
+
+	for (; i + RNG_LANES <= n; i += RNG_LANES) {
+		for (int l = 0; l < RNG_LANES; l++) {
+			uint64_t result = rotl64(s[1][l] * 5, 7) * 9;
+			uint64_t t = s[1][l] << 17;
+			s[2][l] ^= s[0][l];
+			s[3][l] ^= s[1][l];
+			s[1][l] ^= s[2][l];
+			s[0][l] ^= s[3][l];
+			s[2][l] ^= t;
+			s[3][l] = rotl64(s[3][l], 45);
+			out[i + l] = result;
+		}
+	}
+	for (; i < n; i++)
+		out[i] = rng_next();
+}
+
+/**
+ * Map a random word to [0, range) by multiply-high. The bias is at most
+ * range / 2^64, far below what any number of rolls could show.
+ */
+static inline uint64_t rng_range(uint64_t r, uint64_t range) {
+	return (uint64_t)(((unsigned __int128)r * range) >> 64);
+}
+
+//dice of one roll expression, NdM+K
+struct dice {
+	uint64_t count;
+	uint64_t sides;
+	long long modifier;
+	bool implicit_count; // "dM", printed without the faces
+};
+
+/**
+ * Parse [N]dM[+K|-K]
+ * @return false if the expression is invalid or its total may overflow
+ */
+bool parse_dice(const char *input, struct dice *d) {
+	char *end;
+	const char *p = input;
+
+	d->implicit_count = *p == 'd';
+	d->count = 1;
+	if (!d->implicit_count) {
+		if (!isdigit((unsigned char)*p))
+			return false;
+		d->count = strtoull(p, &end, 10);
+		p = end;
+	}
+	if (*p++ != 'd' || !isdigit((unsigned char)*p))
+		return false;
+	d->sides = strtoull(p, &end, 10);
+	p = end;
+
+	d->modifier = 0;
+	if (*p == '+' || *p == '-') {
+		if (!isdigit((unsigned char)p[1]))
+			return false;
+		d->modifier = strtoll(p, &end, 10);
+		p = end;
+	}
+	if (*p != '\0' || d->count == 0 || d->sides == 0 || errno == ERANGE)
+		return false;
+
+	// the largest total has to fit a long long
+	unsigned __int128 max = (unsigned __int128)d->count * d->sides;
+	return max < ((unsigned __int128)1 << 62) && llabs(d->modifier) < (1LL << 62);
+}
+
+#define ROLL_BLOCK 4096
+
+/**
+ * Roll once and print the total and the faces. The generator state is
+ * saved and replayed, so the faces are produced twice (once for the sum
+ * printed first, once for the list) instead of being stored.
+ */
+void roll_once(struct dice *d) {
+	uint64_t block[ROLL_BLOCK];
+	struct rng_state saved = rng;
+	long long sum = d->modifier;
+
+	for (uint64_t left = d->count; left > 0;) {
+		size_t n = left < ROLL_BLOCK ? left : ROLL_BLOCK;
+		rng_fill(block, n);
+		for (size_t i = 0; i < n; i++)
+			sum += 1 + rng_range(block[i], d->sides);
+		left -= n;
+	}
+
+	printf("Rolled %lld", sum);
+	if (!d->implicit_count) {
+		rng = saved;
+		printf(" (");
+		for (uint64_t left = d->count; left > 0;) {
+			size_t n = left < ROLL_BLOCK ? left : ROLL_BLOCK;
+			rng_fill(block, n);
+			for (size_t i = 0; i < n; i++) {
+				printf(left == d->count && i == 0 ? "%llu" : " + %llu",
+					   (unsigned long long)(1 + rng_range(block[i], d->sides)));
+			}
+			left -= n;
+		}
+		printf(")");
+	}
+	if (d->modifier != 0)
+		printf(" %c %lld", d->modifier > 0 ? '+' : '-', llabs(d->modifier));
+	printf("\n");
+}
+
+#define ROLL_BINS 40
+
+/**
+ * Roll many times and print mean, variance and a histogram of the totals.
+ * Only running sums and at most ROLL_BINS counters are kept.
+ */
+void roll_stats(struct dice *d, uint64_t trials) {
+	uint64_t block[ROLL_BLOCK], bins[ROLL_BINS] = {0};
+	size_t pos = ROLL_BLOCK;
+	long long lo = (long long)d->count + d->modifier;
+	long long hi = (long long)(d->count * d->sides) + d->modifier;
+	uint64_t span = (uint64_t)(hi - lo) + 1;
+	int nbins = span < ROLL_BINS ? (int)span : ROLL_BINS;
+	double expected_mean = d->count * (d->sides + 1.0) / 2.0 + d->modifier;
+	double expected_var = d->count * ((double)d->sides * d->sides - 1.0) / 12.0;
+
+	// sums are taken around the expected mean, exactly in integers while
+	// the squares cannot overflow
+	long long shift = (long long)expected_mean, min = hi, max = lo;
+	bool exact = span < (1ULL << 32);
+	__int128 exact_sum = 0, exact_sumsq = 0;
+	long double sum = 0, sumsq = 0;
+
+	for (uint64_t t = 0; t < trials; t++) {
+		long long total = d->modifier;
+		for (uint64_t left = d->count; left > 0;) {
+			if (pos == ROLL_BLOCK) {
+				rng_fill(block, ROLL_BLOCK);
+				pos = 0;
+			}
+			size_t n = ROLL_BLOCK - pos < left ? ROLL_BLOCK - pos : left;
+			for (size_t i = 0; i < n; i++)
+				total += 1 + rng_range(block[pos + i], d->sides);
+			pos += n;
+			left -= n;
+		}
+
+		long long x = total - shift;
+		if (exact) {
+			exact_sum += x;
+			exact_sumsq += (__int128)x * x;
+		} else {
+			sum += x;
+			sumsq += (long double)x * x;
+		}
+		if (total < min)
+			min = total;
+		if (total > max)
+			max = total;
+		if (span <= ROLL_BINS)
+			bins[total - lo]++;
+		else
+			bins[(unsigned __int128)(total - lo) * nbins / span]++;
+	}
+
+	if (exact) {
+		sum = exact_sum;
+		sumsq = exact_sumsq;
+	}
+	long double mean = sum / trials;
+	long double variance = trials > 1 ? (sumsq - sum * mean) / (trials - 1) : 0;
+	printf("Rolls: %llu of %llud%llu", (unsigned long long)trials,
+		   (unsigned long long)d->count, (unsigned long long)d->sides);
+	if (d->modifier != 0)
+		printf("%+lld", d->modifier);
+	printf("\n");
+	printf("Mean: %.4Lf (expected %.4f)\n", mean + shift, expected_mean);
+	printf("Variance: %.4Lf (expected %.4f)\n", variance, expected_var);
+	printf("Min: %lld Max: %lld\n", min, max);
+
+	uint64_t peak = 1;
+	for (int b = 0; b < nbins; b++) {
+		if (bins[b] > peak)
+			peak = bins[b];
+	}
+	// leave out the empty tails
+	int first = 0, last = nbins - 1;
+	while (first < last && bins[first] == 0)
+		first++;
+	while (last > first && bins[last] == 0)
+		last--;
+	for (int b = first; b <= last; b++) {
+		long long from = lo + (long long)((unsigned __int128)span * b / nbins);
+		long long to = lo + (long long)((unsigned __int128)span * (b + 1) / nbins) - 1;
+		char label[48];
+		if (from == to)
+			snprintf(label, sizeof(label), "%lld", from);
+		else
+			snprintf(label, sizeof(label), "%lld-%lld", from, to);
+		printf("%-24s %12llu %6.2f%% ", label, (unsigned long long)bins[b],
+			   100.0 * bins[b] / trials);
+		for (int i = 0; i < (int)(50 * bins[b] / peak); i++)
+			putchar('#');
+		putchar('\n');
+	}
+}
+
+/**
+ * roll [--seed S] [--stats [-n TRIALS]] [N]dM[+K]
+ * @return exit status
+ */
+int roll(struct command_t *command) {
+	bool stats = false;
+	uint64_t trials = 1000000;
+	const char *input = NULL;
+	struct dice d;
+
+	for (int i = 1; command->args[i]; i++) {
+		char *arg = command->args[i];
+		if (strcmp(arg, "--stats") == 0) {
+			stats = true;
+		} else if ((strcmp(arg, "-n") == 0 || strcmp(arg, "--trials") == 0) && command->args[i + 1]) {
+			trials = strtoull(command->args[++i], NULL, 10);
+		} else if (strcmp(arg, "--seed") == 0 && command->args[i + 1]) {
+			rng_seed(strtoull(command->args[++i], NULL, 0));
+		} else {
+			input = arg;
+		}
+	}
+
+	errno = 0;
+	if (input == NULL || !parse_dice(input, &d) || trials == 0) {
+		printf("Invalid input\n");
+		return 1;
+	}
+
+	rng_init();
+	if (stats)
+		roll_stats(&d, trials);
+	else
+		roll_once(&d);
+	return 0;
+}
+
+//cdh part write to file from cd
+void writefile(char* directory) {
+	char *homedir = getenv("HOME");
+	char path[1024];
+	char path2[1024];
+	if (homedir == NULL) {
+		fprintf(stderr, "Error: no HOME env");
+		return;
+	}
+	snprintf(path, sizeof(path), "%s/%s", homedir, "cdh_history.txt");
+
+	FILE *fp = fopen(path, "r+");
+	if (fp == NULL) {
+		// Try creating the file instead
+		fp = fopen(path, "w");
+
+		if (fp == NULL) {
+			fprintf(stderr, "Cannot create or open file for appending: %s\n", strerror(errno));
+			return;
+		}
+
+		fprintf(fp, "%s", directory);
+
+	} else {
+		snprintf(path2, sizeof(path2), "%s/%s", homedir, "temp.txt");
+		FILE *temp = fopen(path2, "w");
+		fprintf(temp, "%s\n", directory);
+
+		char line[256];
+		while (fgets(line, sizeof(line), fp) != NULL) {
+			fprintf(temp, "%s\n", line);
 		}
 
 		fclose(temp);
@@ -603,251 +2814,2781 @@ void cdh() {
 	}
 }
 
-//struct to hold the file values
-struct Info {
-    char name[20]; //to hold extension
-    int files;
-    int blank;
-    int comment;
-    int code;
-
-};
-//cloc command
-void cloc_recursive_helper(char* drc, struct Info *c, struct Info *cpp, struct Info *h, struct Info *hpp, struct Info *python, struct Info *txt, struct Info *info ) {
+//struct to hold the file values
+struct Info {
+    char name[20]; //to hold extension
+    int files;
+    int blank;
+    int comment;
+    int code;
+
+};
+
+/*
+ * Language registry for cloc. Each entry gives the file extensions and
+ * names, the #! interpreters and the comment/string syntax the line
+ * classifier needs. Lookups go through a hash table built on first use.
+ */
+struct language {
+    const char *name;
+    const char *files; // space separated: ".ext" or exact file names
+    const char *interpreters; // space separated #! program names
+    const char *line_comments[3];
+    const char *block_comments[2][2]; // start/end pairs
+    const char *quotes; // string delimiters
+    const char *multiline_quotes; // of those, the strings that may span lines
+    const char *raw_quotes; // and the ones without backslash escapes
+};
+
+struct language languages[] = {
+    {"C", ".c", "", {"//"}, {{"/*", "*/"}}, "\"'"},
+    {"C Header File", ".h", "", {"//"}, {{"/*", "*/"}}, "\"'"},
+    {"C++", ".cpp .cc .cxx .c++ .C", "", {"//"}, {{"/*", "*/"}}, "\"'"},
+    {"C++ Header File", ".hpp .hh .hxx .h++ .inl", "", {"//"}, {{"/*", "*/"}}, "\"'"},
+    {"Python", ".py .pyw .pyi", "python python2 python3", {"#"}, {{"\"\"\"", "\"\"\""}, {"'''", "'''"}}, "\"'"},
+    {"Text", ".txt", "", {0}, {{0}}, ""},
+    {"Objective-C", ".m .mm", "", {"//"}, {{"/*", "*/"}}, "\"'"},
+    {"C#", ".cs", "", {"//"}, {{"/*", "*/"}}, "\"'"},
+    {"Java", ".java", "", {"//"}, {{"/*", "*/"}}, "\"'"},
+    {"Kotlin", ".kt .kts", "", {"//"}, {{"/*", "*/"}}, "\"'"},
+    {"Scala", ".scala .sc", "", {"//"}, {{"/*", "*/"}}, "\"'"},
+    {"Groovy", ".groovy .gradle", "groovy", {"//"}, {{"/*", "*/"}}, "\"'"},
+    {"Go", ".go", "", {"//"}, {{"/*", "*/"}}, "\"'`", "`", "`"},
+    {"Rust", ".rs", "", {"//"}, {{"/*", "*/"}}, "\""},
+    {"Swift", ".swift", "", {"//"}, {{"/*", "*/"}}, "\""},
+    {"Dart", ".dart", "", {"//"}, {{"/*", "*/"}}, "\"'"},
+    {"Zig", ".zig", "", {"//"}, {{0}}, "\"'"},
+    {"JavaScript", ".js .mjs .cjs .jsx", "node nodejs", {"//"}, {{"/*", "*/"}}, "\"'`", "`"},
+    {"TypeScript", ".ts .tsx .mts .cts", "ts-node deno", {"//"}, {{"/*", "*/"}}, "\"'`", "`"},
+    {"PHP", ".php", "php", {"//", "#"}, {{"/*", "*/"}}, "\"'"},
+    {"CSS", ".css", "", {0}, {{"/*", "*/"}}, "\"'"},
+    {"SCSS", ".scss .sass .less", "", {"//"}, {{"/*", "*/"}}, "\"'"},
+    {"HTML", ".html .htm .xhtml", "", {0}, {{"<!--", "-->"}}, ""},
+    {"XML", ".xml .xsd .xsl .svg .plist", "", {0}, {{"<!--", "-->"}}, ""},
+    {"Markdown", ".md .markdown", "", {0}, {{"<!--", "-->"}}, ""},
+    {"JSON", ".json", "", {0}, {{0}}, "\""},
+    {"YAML", ".yml .yaml", "", {"#"}, {{0}}, "\"'"},
+    {"TOML", ".toml", "", {"#"}, {{0}}, "\"'"},
+    {"INI", ".ini .cfg .conf", "", {"#", ";"}, {{0}}, ""},
+    {"Shell", ".sh .bash .zsh .ksh", "sh bash zsh ksh dash ash", {"#"}, {{0}}, "\"'"},
+    {"Fish", ".fish", "fish", {"#"}, {{0}}, "\"'"},
+    {"PowerShell", ".ps1 .psm1", "pwsh", {"#"}, {{"<#", "#>"}}, "\"'"},
+    {"Perl", ".pl .pm .t", "perl", {"#"}, {{0}}, "\"'"},
+    {"Ruby", ".rb .rake .gemspec Rakefile Gemfile", "ruby", {"#"}, {{"=begin", "=end"}}, "\"'"},
+    {"Lua", ".lua", "lua luajit", {"--"}, {{"--[[", "]]"}}, "\"'"},
+    {"Tcl", ".tcl", "tclsh wish", {"#"}, {{0}}, "\""},
+    {"R", ".r .R", "Rscript", {"#"}, {{0}}, "\"'"},
+    {"Julia", ".jl", "julia", {"#"}, {{"#=", "=#"}}, "\""},
+    {"Haskell", ".hs .lhs", "runhaskell", {"--"}, {{"{-", "-}"}}, "\""},
+    {"OCaml", ".ml .mli", "ocaml", {0}, {{"(*", "*)"}}, "\""},
+    {"F#", ".fs .fsi .fsx", "", {"//"}, {{"(*", "*)"}}, "\""},
+    {"Erlang", ".erl .hrl", "escript", {"%"}, {{0}}, "\""},
+    {"Elixir", ".ex .exs", "elixir", {"#"}, {{0}}, "\"'"},
+    {"Clojure", ".clj .cljs .cljc .edn", "", {";"}, {{0}}, "\""},
+    {"Lisp", ".lisp .lsp .cl .el .scm .rkt", "sbcl guile racket", {";"}, {{"#|", "|#"}}, "\""},
+    {"SQL", ".sql", "", {"--"}, {{"/*", "*/"}}, "'"},
+    {"Assembly", ".s .S .asm", "", {";", "#"}, {{"/*", "*/"}}, "\"'"},
+    {"Fortran", ".f90 .f95 .f03 .f08", "", {"!"}, {{0}}, "\"'"},
+    {"Pascal", ".pas .pp", "", {"//"}, {{"{", "}"}, {"(*", "*)"}}, "'"},
+    {"VHDL", ".vhd .vhdl", "", {"--"}, {{0}}, "\""},
+    {"Verilog", ".v .sv .svh", "", {"//"}, {{"/*", "*/"}}, "\""},
+    {"Vim Script", ".vim .vimrc", "", {"\""}, {{0}}, "'"},
+    {"Protocol Buffers", ".proto", "", {"//"}, {{"/*", "*/"}}, "\"'"},
+    {"Nim", ".nim", "", {"#"}, {{"#[", "]#"}}, "\""},
+    {"D", ".d", "", {"//"}, {{"/*", "*/"}, {"/+", "+/"}}, "\"'`", "\"`", "`"},
+    {"make", ".mk .mak Makefile makefile GNUmakefile", "make", {"#"}, {{0}}, ""},
+    {"CMake", ".cmake CMakeLists.txt", "", {"#"}, {{0}}, "\""},
+    {"Dockerfile", ".dockerfile Dockerfile Containerfile", "", {"#"}, {{0}}, ""},
+    {"AWK", ".awk", "awk gawk mawk", {"#"}, {{0}}, "\""},
+};
+
+#define LANGUAGE_COUNT ((int)(sizeof(languages) / sizeof(languages[0])))
+
+//extension, file name or "!interpreter" -> index into languages
+#define REGISTRY_SIZE 1024
+struct registry_slot {
+    const char *key;
+    int length;
+    int language;
+};
+struct registry_slot language_registry[REGISTRY_SIZE];
+bool language_registry_ready = false;
+
+//bytes that may start a comment or a string, per language
+bool language_starts[LANGUAGE_COUNT][256];
+
+void registry_add(const char *key, int length, int language) {
+    unsigned long i = hash_bytes(key, length) & (REGISTRY_SIZE - 1);
+    while (language_registry[i].key != NULL)
+        i = (i + 1) & (REGISTRY_SIZE - 1);
+    language_registry[i].key = key;
+    language_registry[i].length = length;
+    language_registry[i].language = language;
+}
+
+/**
+ * Language of a key, -1 if none
+ */
+int registry_find(const char *key, int length) {
+    unsigned long i = hash_bytes(key, length) & (REGISTRY_SIZE - 1);
+    while (language_registry[i].key != NULL) {
+        struct registry_slot *slot = &language_registry[i];
+        if (slot->length == length && memcmp(slot->key, key, length) == 0)
+            return slot->language;
+        i = (i + 1) & (REGISTRY_SIZE - 1);
+    }
+    return -1;
+}
+
+void registry_init() {
+    static char interpreter_keys[4096];
+    size_t used = 0;
+
+    if (language_registry_ready)
+        return;
+    for (int l = 0; l < LANGUAGE_COUNT; l++) {
+        // keys point into the table strings, words are not NUL terminated
+        for (const char *p = languages[l].files; *p;) {
+            int len = strcspn(p, " ");
+            registry_add(p, len, l);
+            p += len + (p[len] == ' ');
+        }
+        for (const char *p = languages[l].interpreters; *p;) {
+            int len = strcspn(p, " ");
+            if (used + len + 1 <= sizeof(interpreter_keys)) {
+                interpreter_keys[used] = '!';
+                memcpy(interpreter_keys + used + 1, p, len);
+                registry_add(interpreter_keys + used, len + 1, l);
+                used += len + 1;
+            }
+            p += len + (p[len] == ' ');
+        }
+
+        bool *starts = language_starts[l];
+        for (int i = 0; i < 3 && languages[l].line_comments[i]; i++)
+            starts[(unsigned char)languages[l].line_comments[i][0]] = true;
+        for (int b = 0; b < 2 && languages[l].block_comments[b][0]; b++)
+            starts[(unsigned char)languages[l].block_comments[b][0][0]] = true;
+        for (const char *q = languages[l].quotes; *q; q++)
+            starts[(unsigned char)*q] = true;
+    }
+    language_registry_ready = true;
+}
+
+/**
+ * Language of a file from its name: exact name first (Makefile), then
+ * the extension. Files without a match may still have a #! line.
+ */
+int language_of_name(const char *name) {
+    int l = registry_find(name, strlen(name));
+    if (l != -1)
+        return l;
+    const char *extension = strrchr(name, '.');
+    if (extension == NULL || extension == name)
+        return -1;
+    return registry_find(extension, strlen(extension));
+}
+
+/**
+ * Language from a "#!/usr/bin/env python3 -u" style first line
+ */
+int language_of_shebang(const char *buf, size_t len) {
+    if (len < 2 || buf[0] != '#' || buf[1] != '!')
+        return -1;
+
+    const char *end = memchr(buf, '\n', len);
+    if (end == NULL)
+        end = buf + len;
+    const char *p = buf + 2;
+    while (p < end && (*p == ' ' || *p == '\t'))
+        p++;
+
+    // program name is the basename of the first word, or the word after env
+    for (int word = 0; word < 2 && p < end; word++) {
+        const char *start = p;
+        while (p < end && *p != ' ' && *p != '\t' && *p != '\r')
+            p++;
+        const char *base = start;
+        for (const char *q = start; q < p; q++) {
+            if (*q == '/')
+                base = q + 1;
+        }
+        if (p - base == 3 && memcmp(base, "env", 3) == 0) {
+            while (p < end && (*p == ' ' || *p == '\t'))
+                p++;
+            continue;
+        }
+
+        char key[64];
+        int len = p - base;
+        if (len == 0 || len >= (int)sizeof(key) - 1)
+            return -1;
+        key[0] = '!';
+        memcpy(key + 1, base, len);
+        int l = registry_find(key, len + 1);
+        // python3.11 -> python3
+        while (l == -1 && len > 0 && (isdigit((unsigned char)key[len]) || key[len] == '.'))
+            l = registry_find(key, len--);
+        return l;
+    }
+    return -1;
+}
+
+//state of the line classifier, carried across read blocks
+enum lexer_mode {
+    LEX_CODE,
+    LEX_LINE_COMMENT,
+    LEX_BLOCK_COMMENT,
+    LEX_STRING,
+};
+
+struct lexer {
+    const struct language *language;
+    const bool *starts; // language_starts of the language
+    enum lexer_mode mode;
+    int block; // which block comment pair is open
+    char quote; // open string delimiter
+    bool multiline; // the open string goes on past the end of the line
+    bool raw; // and has no backslash escapes
+    bool has_code; // current line
+    bool has_comment;
+    int blank;
+    int comment;
+    int code;
+};
+
+#define LEXER_MAX_TOKEN 8
+
+static inline bool token_at(const char *p, const char *end, const char *token) {
+    size_t len = strlen(token);
+    return (size_t)(end - p) >= len && memcmp(p, token, len) == 0;
+}
+
+static inline void lexer_end_line(struct lexer *lx) {
+    if (lx->has_code)
+        lx->code++;
+    else if (lx->has_comment)
+        lx->comment++;
+    else
+        lx->blank++;
+    lx->has_code = lx->has_comment = false;
+}
+
+/**
+ * Classify the bytes of buf. Unless at_eof, it stops short of the last
+ * LEXER_MAX_TOKEN - 1 bytes so no comment token is cut by a block edge.
+ * @return bytes consumed
+ */
+size_t lexer_feed(struct lexer *lx, const char *buf, size_t len, bool at_eof) {
+    const struct language *lang = lx->language;
+    const char *p = buf, *end = buf + len;
+    const char *stop = at_eof || len < LEXER_MAX_TOKEN ? end : end - (LEXER_MAX_TOKEN - 1);
+    if (!at_eof && len < LEXER_MAX_TOKEN)
+        return 0;
+
+    while (p < stop) {
+        char c = *p;
+        if (c == '\n') {
+            lexer_end_line(lx);
+            if (lx->mode == LEX_LINE_COMMENT || (lx->mode == LEX_STRING && !lx->multiline))
+                lx->mode = LEX_CODE; // other unterminated strings end with the line
+            p++;
+            continue;
+        }
+        bool space = c == ' ' || c == '\t' || c == '\r' || c == '\f' || c == '\v';
+
+        switch (lx->mode) {
+        case LEX_CODE:
+            if (space) {
+                p++;
+                break;
+            }
+            if (!lx->starts[(unsigned char)c]) {
+                lx->has_code = true;
+                p++;
+                break;
+            }
+            for (int b = 0; b < 2 && lang->block_comments[b][0]; b++) {
+                if (token_at(p, end, lang->block_comments[b][0])) {
+                    lx->mode = LEX_BLOCK_COMMENT;
+                    lx->block = b;
+                    lx->has_comment = true;
+                    p += strlen(lang->block_comments[b][0]);
+                    goto next;
+                }
+            }
+            for (int i = 0; i < 3 && lang->line_comments[i]; i++) {
+                if (token_at(p, end, lang->line_comments[i])) {
+                    lx->mode = LEX_LINE_COMMENT;
+                    lx->has_comment = true;
+                    p++;
+                    goto next;
+                }
+            }
+            if (c != '\0' && strchr(lang->quotes, c)) {
+                lx->mode = LEX_STRING;
+                lx->quote = c;
+                lx->multiline = lang->multiline_quotes && strchr(lang->multiline_quotes, c);
+                lx->raw = lang->raw_quotes && strchr(lang->raw_quotes, c);
+            }
+            lx->has_code = true;
+            p++;
+            break;
+
+        case LEX_LINE_COMMENT: {
+            const char *newline = memchr(p, '\n', stop - p);
+            p = newline ? newline : stop;
+            break;
+        }
+
+        case LEX_BLOCK_COMMENT:
+            if (token_at(p, end, lang->block_comments[lx->block][1])) {
+                lx->mode = LEX_CODE;
+                lx->has_comment = true;
+                p += strlen(lang->block_comments[lx->block][1]);
+                break;
+            }
+            if (!space)
+                lx->has_comment = true;
+            p++;
+            break;
+
+        case LEX_STRING:
+            if (c == '\\' && !lx->raw && p + 1 < end) {
+                // an escaped newline keeps the string open
+                if (p[1] == '\n') {
+                    lexer_end_line(lx);
+                    lx->has_code = true;
+                }
+                p += 2;
+                break;
+            }
+            if (c == lx->quote)
+                lx->mode = LEX_CODE;
+            lx->has_code = true;
+            p++;
+            break;
+        }
+    next:;
+    }
+
+    if (at_eof && (lx->has_code || lx->has_comment))
+        lexer_end_line(lx); // last line without a newline
+    return p - buf;
+}
+
+#define CLOC_BLOCK 65536
+
+/*
+ * XXH64, streaming form, so cloc can hash a file in the same pass that
+ * classifies its lines
+ */
+#define XXH_PRIME1 11400714785074694791ULL
+#define XXH_PRIME2 14029467366897019727ULL
+#define XXH_PRIME3 1609587929392839161ULL
+#define XXH_PRIME4 9650029242287828579ULL
+#define XXH_PRIME5 2870177450012600261ULL
+
+struct xxh64_state {
+    uint64_t v[4];
+    uint64_t total;
+    unsigned char mem[32];
+    size_t memsize;
+};
+
+static inline uint64_t xxh64_read(const unsigned char *p) {
+    uint64_t v;
+    memcpy(&v, p, sizeof(v));
+    return v; // little-endian hosts only
+}
+
+static inline uint64_t xxh64_round(uint64_t acc, uint64_t input) {
+    acc += input * XXH_PRIME2;
+    acc = rotl64(acc, 31);
+    return acc * XXH_PRIME1;
+}
+
+static inline uint64_t xxh64_merge(uint64_t acc, uint64_t v) {
+    acc ^= xxh64_round(0, v);
+    return acc * XXH_PRIME1 + XXH_PRIME4;
+}
+
+void xxh64_reset(struct xxh64_state *s) {
+    memset(s, 0, sizeof(*s));
+    s->v[0] = XXH_PRIME1 + XXH_PRIME2;
+    s->v[1] = XXH_PRIME2;
+    s->v[2] = 0;
+    s->v[3] = -XXH_PRIME1;
+}
+
+void xxh64_update(struct xxh64_state *s, const void *data, size_t len) {
+    const unsigned char *p = data, *end = p + len;
+    s->total += len;
+
+    if (s->memsize + len < 32) {
+        memcpy(s->mem + s->memsize, p, len);
+        s->memsize += len;
+        return;
+    }
+    if (s->memsize) {
+        memcpy(s->mem + s->memsize, p, 32 - s->memsize);
+        p += 32 - s->memsize;
+        for (int i = 0; i < 4; i++)
+            s->v[i] = xxh64_round(s->v[i], xxh64_read(s->mem + 8 * i));
+        s->memsize = 0;
+    }
+    for (; p + 32 <= end; p += 32) {
+        for (int i = 0; i < 4; i++)
+            s->v[i] = xxh64_round(s->v[i], xxh64_read(p + 8 * i));
+    }
+    memcpy(s->mem, p, end - p);
+    s->memsize = end - p;
+}
+
+uint64_t xxh64_digest(struct xxh64_state *s) {
+    uint64_t h;
+    const unsigned char *p = s->mem, *end = s->mem + s->memsize;
+
+    if (s->total >= 32) {
+        h = rotl64(s->v[0], 1) + rotl64(s->v[1], 7) + rotl64(s->v[2], 12) + rotl64(s->v[3], 18);
+        for (int i = 0; i < 4; i++)
+            h = xxh64_merge(h, s->v[i]);
+    } else {
+        h = s->v[2] + XXH_PRIME5;
+    }
+    h += s->total;
+
+    for (; p + 8 <= end; p += 8) {
+        h ^= xxh64_round(0, xxh64_read(p));
+        h = rotl64(h, 27) * XXH_PRIME1 + XXH_PRIME4;
+    }
+    if (p + 4 <= end) {
+        uint32_t v;
+        memcpy(&v, p, sizeof(v));
+        h ^= (uint64_t)v * XXH_PRIME1;
+        h = rotl64(h, 23) * XXH_PRIME2 + XXH_PRIME3;
+        p += 4;
+    }
+    for (; p < end; p++) {
+        h ^= *p * XXH_PRIME5;
+        h = rotl64(h, 11) * XXH_PRIME1;
+    }
+    h ^= h >> 33;
+    h *= XXH_PRIME2;
+    h ^= h >> 29;
+    h *= XXH_PRIME3;
+    h ^= h >> 32;
+    return h;
+}
+
+/*
+ * cloc --dedupe: files are grouped by size first. The first file of a
+ * size is never hashed unless a second one shows up, then it is hashed
+ * once and later files of that size are hashed while being counted.
+ */
+struct size_group {
+    off_t size;
+    char *first_path; // not hashed yet, NULL once it is
+    uint64_t *hashes;
+    int count;
+};
+
+struct dedupe_table {
+    struct size_group *groups; // open addressing on the size
+    size_t cap;
+    size_t used;
+    int duplicates;
+};
+
+struct size_group *dedupe_group(struct dedupe_table *t, off_t size) {
+    if (2 * (t->used + 1) > t->cap) {
+        struct size_group *old = t->groups;
+        size_t old_cap = t->cap;
+        t->cap = t->cap ? t->cap * 2 : 1024;
+        t->groups = calloc(t->cap, sizeof(struct size_group));
+        for (size_t i = 0; i < old_cap; i++) {
+            if (old[i].count == 0 && old[i].first_path == NULL)
+                continue;
+            size_t j = hash_bytes((const char *)&old[i].size, sizeof(off_t)) & (t->cap - 1);
+            while (t->groups[j].first_path || t->groups[j].count)
+                j = (j + 1) & (t->cap - 1);
+            t->groups[j] = old[i];
+        }
+        free(old);
+    }
+
+    size_t i = hash_bytes((const char *)&size, sizeof(off_t)) & (t->cap - 1);
+    while (t->groups[i].first_path || t->groups[i].count) {
+        if (t->groups[i].size == size)
+            return &t->groups[i];
+        i = (i + 1) & (t->cap - 1);
+    }
+    t->groups[i].size = size;
+    t->used++;
+    return &t->groups[i];
+}
+
+void dedupe_add_hash(struct size_group *g, uint64_t hash) {
+    g->hashes = realloc(g->hashes, (g->count + 1) * sizeof(uint64_t));
+    g->hashes[g->count++] = hash;
+}
+
+bool dedupe_seen(struct size_group *g, uint64_t hash) {
+    for (int i = 0; i < g->count; i++) {
+        if (g->hashes[i] == hash)
+            return true;
+    }
+    return false;
+}
+
+//hash the first file of a size group now that it has company
+void dedupe_hash_first(struct size_group *g) {
+    char buf[CLOC_BLOCK];
+    struct xxh64_state state;
+    ssize_t n;
+
+    xxh64_reset(&state);
+    int fd = open(g->first_path, O_RDONLY);
+    if (fd != -1) {
+        while ((n = read(fd, buf, sizeof(buf))) > 0)
+            xxh64_update(&state, buf, n);
+        close(fd);
+    }
+    dedupe_add_hash(g, xxh64_digest(&state));
+    free(g->first_path);
+    g->first_path = NULL;
+}
+
+void dedupe_free(struct dedupe_table *t) {
+    for (size_t i = 0; i < t->cap; i++) {
+        free(t->groups[i].first_path);
+        free(t->groups[i].hashes);
+    }
+    free(t->groups);
+}
+
+/*
+ * Directory walker shared by the tree commands. Directories are pruned
+ * before they are opened: VCS directories, names given with
+ * --exclude-dir and anything matched by a .gitignore or .clocignore on
+ * the way down. Ignore files are compiled once when their directory is
+ * entered and dropped again when it is left.
+ */
+enum ignore_kind {
+    IGNORE_LITERAL, // "build", compared with the entry name
+    IGNORE_SUFFIX,  // "*.o", compared with the end of the name
+    IGNORE_GLOB,    // any other pattern without a slash, on the name
+    IGNORE_PATH     // pattern with a slash, on the path below its directory
+};
+
+struct ignore_rule {
+    int kind;
+    bool negate;
+    bool dir_only;
+    char *pattern;
+    size_t len;
+    char **segments; // IGNORE_PATH, split on '/'
+    int segment_count;
+    size_t base; // where paths relative to the ignore file start in walker.path
+};
+
+struct walker {
+    struct ignore_rule *rules;
+    int rule_count;
+    int rule_cap;
+    struct word_list exclude_dirs;
+    bool use_ignore_files;
+    char path[PATH_MAX];
+    // called for every regular file that is not ignored; may be NULL
+    void (*visit_file)(struct walker *w, const char *path, const char *name);
+    // called for every directory entered, the root included; may be NULL
+    void (*visit_dir)(struct walker *w, const char *path);
+    void *data;
+};
+
+const char *vcs_dirs[] = {".git", ".hg", ".svn", ".bzr", "_darcs", "CVS", NULL};
+
+void walker_init(struct walker *w) {
+    memset(w, 0, sizeof(*w));
+    w->use_ignore_files = true;
+    for (int i = 0; vcs_dirs[i]; i++)
+        word_list_add(&w->exclude_dirs, strdup(vcs_dirs[i]));
+}
+
+void walker_free(struct walker *w) {
+    for (int i = 0; i < w->exclude_dirs.count; i++)
+        free(w->exclude_dirs.words[i]);
+    free(w->exclude_dirs.words);
+    free(w->rules);
+}
+
+//add a comma separated list of directory names to skip
+void walker_exclude(struct walker *w, const char *names) {
+    char *copy = strdup(names), *save, *name;
+    for (name = strtok_r(copy, ",", &save); name; name = strtok_r(NULL, ",", &save))
+        word_list_add(&w->exclude_dirs, strdup(name));
+    free(copy);
+}
+
+/**
+ * Compile one line of an ignore file
+ * @return false for blank lines and comments
+ */
+bool ignore_compile(char *line, struct ignore_rule *rule) {
+    size_t len = strlen(line);
+    while (len > 0 && (line[len - 1] == '\n' || line[len - 1] == '\r'))
+        len--;
+    while (len > 0 && line[len - 1] == ' ' && (len < 2 || line[len - 2] != '\\'))
+        len--; // trailing spaces unless escaped
+    line[len] = '\0';
+    if (len == 0 || line[0] == '#')
+        return false;
+
+    memset(rule, 0, sizeof(*rule));
+    if (line[0] == '!') {
+        rule->negate = true;
+        line++;
+        len--;
+    } else if (line[0] == '\\' && (line[1] == '#' || line[1] == '!')) {
+        line++;
+        len--;
+    }
+    if (len > 0 && line[len - 1] == '/') {
+        rule->dir_only = true;
+        line[--len] = '\0';
+    }
+    if (strncmp(line, "**/", 3) == 0 && strchr(line + 3, '/') == NULL) {
+        line += 3; // "**/name" is the same as "name"
+        len -= 3;
+    }
+    if (len == 0)
+        return false;
+
+    if (strchr(line, '/') != NULL) {
+        rule->kind = IGNORE_PATH;
+        if (line[0] == '/')
+            line++;
+        rule->pattern = strdup(line);
+        char *save, *seg;
+        for (seg = strtok_r(rule->pattern, "/", &save); seg; seg = strtok_r(NULL, "/", &save)) {
+            rule->segments = realloc(rule->segments, (rule->segment_count + 1) * sizeof(char *));
+            rule->segments[rule->segment_count++] = seg;
+        }
+        if (rule->segment_count == 0) {
+            free(rule->pattern);
+            return false;
+        }
+    } else if (!has_glob_chars(line)) {
+        rule->kind = IGNORE_LITERAL;
+        rule->pattern = strdup(line);
+    } else if (line[0] == '*' && !has_glob_chars(line + 1)) {
+        rule->kind = IGNORE_SUFFIX;
+        rule->pattern = strdup(line + 1);
+    } else {
+        rule->kind = IGNORE_GLOB;
+        rule->pattern = strdup(line);
+    }
+    rule->len = strlen(rule->pattern);
+    return true;
+}
+
+//read the ignore file name in the directory open as dir_fd
+void walker_load_ignore(struct walker *w, int dir_fd, const char *name, size_t base) {
+    int fd = openat(dir_fd, name, O_RDONLY);
+    if (fd == -1)
+        return;
+    FILE *fp = fdopen(fd, "r");
+    if (fp == NULL) {
+        close(fd);
+        return;
+    }
+
+    char *line = NULL;
+    size_t cap = 0;
+    while (getline(&line, &cap, fp) != -1) {
+        struct ignore_rule rule;
+        if (!ignore_compile(line, &rule))
+            continue;
+        rule.base = base;
+        if (w->rule_count == w->rule_cap) {
+            w->rule_cap = w->rule_cap ? w->rule_cap * 2 : 16;
+            w->rules = realloc(w->rules, w->rule_cap * sizeof(struct ignore_rule));
+        }
+        w->rules[w->rule_count++] = rule;
+    }
+    free(line);
+    fclose(fp);
+}
+
+//drop the rules of directories that were left
+void walker_pop_rules(struct walker *w, int count) {
+    while (w->rule_count > count) {
+        struct ignore_rule *rule = &w->rules[--w->rule_count];
+        free(rule->pattern);
+        free(rule->segments);
+    }
+}
+
+//match path segments, where "**" stands for any number of them
+bool ignore_match_path(char **seg, int n, const char *path) {
+    if (n == 0)
+        return *path == '\0';
+    if (strcmp(seg[0], "**") == 0) {
+        if (n == 1)
+            return *path != '\0';
+        for (const char *p = path;; p++) {
+            if (ignore_match_path(seg + 1, n - 1, p))
+                return true;
+            p = strchr(p, '/');
+            if (p == NULL)
+                return false;
+        }
+    }
+
+    const char *slash = strchr(path, '/');
+    size_t len = slash ? (size_t)(slash - path) : strlen(path);
+    char name[NAME_MAX + 1];
+    if (len > NAME_MAX)
+        return false;
+    memcpy(name, path, len);
+    name[len] = '\0';
+    if (!glob_match(seg[0], name))
+        return false;
+    if (slash == NULL)
+        return n == 1;
+    return ignore_match_path(seg + 1, n - 1, slash + 1);
+}
+
+/**
+ * Check the ignore rules for the entry whose path is in w->path
+ * @return true if the last rule that matches excludes it
+ */
+bool walker_ignored(struct walker *w, const char *name, size_t name_len, bool is_dir) {
+    for (int i = w->rule_count - 1; i >= 0; i--) {
+        struct ignore_rule *rule = &w->rules[i];
+        if (rule->dir_only && !is_dir)
+            continue;
+
+        bool match;
+        switch (rule->kind) {
+        case IGNORE_LITERAL:
+            match = rule->len == name_len && memcmp(rule->pattern, name, name_len) == 0;
+            break;
+        case IGNORE_SUFFIX:
+            match = rule->len <= name_len &&
+                    memcmp(rule->pattern, name + name_len - rule->len, rule->len) == 0;
+            break;
+        case IGNORE_GLOB:
+            match = glob_match(rule->pattern, name);
+            break;
+        default:
+            match = ignore_match_path(rule->segments, rule->segment_count, w->path + rule->base);
+            break;
+        }
+        if (match)
+            return !rule->negate;
+    }
+    return false;
+}
+
+bool walker_excluded_dir(struct walker *w, const char *name) {
+    for (int i = 0; i < w->exclude_dirs.count; i++) {
+        if (strcmp(w->exclude_dirs.words[i], name) == 0)
+            return true;
+    }
+    return false;
+}
+
+//walk the directory whose path fills w->path[0..len)
+void walker_descend(struct walker *w, size_t len) {
+    DIR *dir = opendir(w->path);
+    if (dir == NULL)
+        return;
+    if (w->visit_dir)
+        w->visit_dir(w, w->path);
+
+    int rules_before = w->rule_count;
+    if (w->use_ignore_files) {
+        walker_load_ignore(w, dirfd(dir), ".gitignore", len + 1);
+        walker_load_ignore(w, dirfd(dir), ".clocignore", len + 1);
+    }
+
+    struct dirent *entry;
+    while ((entry = readdir(dir)) != NULL) {
+        const char *name = entry->d_name;
+        if (strcmp(name, ".") == 0 || strcmp(name, "..") == 0) {
+            continue; // skip current and parent directory links
+        }
+        size_t name_len = strlen(name);
+        if (len + 1 + name_len >= sizeof(w->path))
+            continue;
+        w->path[len] = '/';
+        memcpy(w->path + len + 1, name, name_len + 1);
+
+        unsigned char type = entry->d_type;
+        if (type == DT_UNKNOWN) {
+            // some file systems do not fill d_type
+            struct stat st;
+            if (lstat(w->path, &st) == -1)
+                continue;
+            type = S_ISDIR(st.st_mode) ? DT_DIR : S_ISREG(st.st_mode) ? DT_REG : DT_UNKNOWN;
+        }
+
+        if (type == DT_DIR) {
+            if (walker_excluded_dir(w, name) || walker_ignored(w, name, name_len, true))
+                continue; // pruned without ever being opened
+            walker_descend(w, len + 1 + name_len);
+        } else if (type == DT_REG) {
+            if (w->visit_file == NULL || walker_ignored(w, name, name_len, false))
+                continue;
+            w->visit_file(w, w->path, name);
+        }
+    }
+    w->path[len] = '\0';
+    walker_pop_rules(w, rules_before);
+    closedir(dir);
+}
+
+/**
+ * Decide whether the walk from root would skip path, a file or directory
+ * somewhere below it, loading the ignore files of the directories between
+ * @return true if path or one of its parents is pruned
+ */
+bool walker_skips(struct walker *w, const char *root, const char *path, bool is_dir) {
+    size_t dir_len = strlen(root);
+    while (dir_len > 1 && root[dir_len - 1] == '/')
+        dir_len--;
+    if (strlen(path) >= sizeof(w->path) || strncmp(path, root, dir_len) != 0 ||
+        path[dir_len] != '/')
+        return false;
+    strcpy(w->path, path);
+
+    int rules_before = w->rule_count;
+    bool skipped = false;
+    while (!skipped) {
+        if (w->use_ignore_files) {
+            w->path[dir_len] = '\0';
+            int fd = open(w->path, O_RDONLY | O_DIRECTORY | O_CLOEXEC);
+            w->path[dir_len] = '/';
+            if (fd != -1) {
+                walker_load_ignore(w, fd, ".gitignore", dir_len + 1);
+                walker_load_ignore(w, fd, ".clocignore", dir_len + 1);
+                close(fd);
+            }
+        }
+
+        char *name = w->path + dir_len + 1;
+        char *slash = strchr(name, '/');
+        if (slash)
+            *slash = '\0'; // rules see the path up to this component
+        size_t name_len = strlen(name);
+        bool dir = slash != NULL || is_dir;
+        skipped = (dir && walker_excluded_dir(w, name)) || walker_ignored(w, name, name_len, dir);
+        if (slash == NULL)
+            break;
+        *slash = '/';
+        dir_len += 1 + name_len;
+    }
+    walker_pop_rules(w, rules_before);
+    return skipped;
+}
+
+void walker_run(struct walker *w, const char *root) {
+    size_t len = strlen(root);
+    if (len >= sizeof(w->path))
+        return;
+    memcpy(w->path, root, len + 1);
+    while (len > 1 && w->path[len - 1] == '/')
+        w->path[--len] = '\0';
+    walker_descend(w, len);
+}
+
+//bytes of the first block searched for a NUL, as git does
+#define BINARY_PROBE 8000
+
+/**
+ * Count the lines of one file in a single pass over its bytes. With
+ * dedupe, the same pass hashes the file when its size is not unique.
+ * @return false if the file is not source code of a known language, is
+ *         larger than max_size, looks binary or is a duplicate
+ */
+bool cloc_count_file(const char *path, int language, struct lexer *lx,
+                     struct dedupe_table *dedupe, off_t max_size) {
+    static char buf[CLOC_BLOCK + LEXER_MAX_TOKEN];
+    struct size_group *group = NULL;
+    struct xxh64_state state;
+    struct stat st;
+
+    int fd = open(path, O_RDONLY);
+    if (fd == -1)
+        return false;
+    if (fstat(fd, &st) == -1 || (max_size > 0 && st.st_size > max_size)) {
+        close(fd);
+        return false;
+    }
+
+    size_t kept = 0;
+    bool first = true;
+    while (1) {
+        ssize_t n = read(fd, buf + kept, CLOC_BLOCK);
+        if (n == -1 && errno == EINTR)
+            continue;
+        if (n < 0)
+            n = 0;
+        size_t len = kept + n;
+
+        if (first) {
+            first = false;
+            if (language == -1)
+                language = language_of_shebang(buf, len);
+            if (language == -1 || memchr(buf, '\0', len < BINARY_PROBE ? len : BINARY_PROBE)) {
+                close(fd);
+                return false;
+            }
+            // only source files take part in deduplication
+            if (dedupe != NULL) {
+                group = dedupe_group(dedupe, st.st_size);
+                if (group->first_path == NULL && group->count == 0) {
+                    group->first_path = strdup(path); // unique so far, no hashing
+                    group = NULL;
+                } else {
+                    if (group->first_path != NULL)
+                        dedupe_hash_first(group);
+                    xxh64_reset(&state);
+                }
+            }
+            memset(lx, 0, sizeof(*lx));
+            lx->language = &languages[language];
+            lx->starts = language_starts[language];
+        }
+        if (group != NULL)
+            xxh64_update(&state, buf + kept, n);
+
+        size_t used = lexer_feed(lx, buf, len, n == 0);
+        if (n == 0)
+            break;
+        kept = len - used;
+        memmove(buf, buf + used, kept);
+    }
+    close(fd);
+    lx->language = &languages[language];
+
+    if (group != NULL) {
+        uint64_t hash = xxh64_digest(&state);
+        if (dedupe_seen(group, hash)) {
+            dedupe->duplicates++;
+            return false;
+        }
+        dedupe_add_hash(group, hash);
+    }
+    return true;
+}
+
+//cloc command
+struct cloc_run {
+    struct Info *totals;
+    struct Info *info;
+    struct dedupe_table *dedupe;
+    off_t max_size;
+};
+
+/*
+ * Per-file results kept across cloc runs, keyed on the path and checked
+ * against the file's stat, so a rerun (as under watch-run) only reads the
+ * files that changed. Skipped files are remembered too, with language -1.
+ */
+struct cloc_cached {
+    char *path;
+    dev_t dev;
+    ino_t ino;
+    off_t size;
+    struct timespec mtime;
+    struct timespec ctime;
+    int language;
+    int blank;
+    int comment;
+    int code;
+};
+
+#define CLOC_CACHE_MAX 262144 // entries, the table is dropped beyond that
+
+struct cloc_cached *cloc_cache = NULL;
+size_t cloc_cache_cap = 0;
+size_t cloc_cache_used = 0;
+
+void cloc_cache_clear() {
+    for (size_t i = 0; i < cloc_cache_cap; i++)
+        free(cloc_cache[i].path);
+    free(cloc_cache);
+    cloc_cache = NULL;
+    cloc_cache_cap = cloc_cache_used = 0;
+}
+
+//slot of path, the empty one it would go in if it is not cached
+struct cloc_cached *cloc_cache_slot(const char *path) {
+    if (2 * (cloc_cache_used + 1) > cloc_cache_cap) {
+        if (cloc_cache_used >= CLOC_CACHE_MAX)
+            cloc_cache_clear();
+        struct cloc_cached *old = cloc_cache;
+        size_t old_cap = cloc_cache_cap;
+        cloc_cache_cap = old_cap ? old_cap * 2 : 4096;
+        cloc_cache = calloc(cloc_cache_cap, sizeof(struct cloc_cached));
+        for (size_t i = 0; i < old_cap; i++) {
+            if (old[i].path == NULL)
+                continue;
+            size_t j = hash_string(old[i].path) & (cloc_cache_cap - 1);
+            while (cloc_cache[j].path)
+                j = (j + 1) & (cloc_cache_cap - 1);
+            cloc_cache[j] = old[i];
+        }
+        free(old);
+    }
+
+    size_t i = hash_string(path) & (cloc_cache_cap - 1);
+    while (cloc_cache[i].path && strcmp(cloc_cache[i].path, path) != 0)
+        i = (i + 1) & (cloc_cache_cap - 1);
+    return &cloc_cache[i];
+}
+
+bool cloc_cache_fresh(const struct cloc_cached *e, const struct stat *st) {
+    return e->path && e->dev == st->st_dev && e->ino == st->st_ino &&
+           e->size == st->st_size &&
+           e->mtime.tv_sec == st->st_mtim.tv_sec && e->mtime.tv_nsec == st->st_mtim.tv_nsec &&
+           e->ctime.tv_sec == st->st_ctim.tv_sec && e->ctime.tv_nsec == st->st_ctim.tv_nsec;
+}
+
+void cloc_add(struct cloc_run *run, int language, int blank, int comment, int code) {
+    struct Info *t = &run->totals[language];
+    t->files++;
+    t->blank += blank;
+    t->comment += comment;
+    t->code += code;
+    run->info->files++;
+    run->info->blank += blank;
+    run->info->comment += comment;
+    run->info->code += code;
+}
+
+void cloc_visit_file(struct walker *w, const char *path, const char *name) {
+    struct cloc_run *run = w->data;
+    struct lexer lx;
+    struct stat st;
+
+    int language = language_of_name(name);
+    if (language == -1 && strchr(name, '.') != NULL)
+        return; // unknown extension, only extensionless files may have #!
+
+    // duplicates depend on the other files of the run, so no caching then
+    if (run->dedupe != NULL) {
+        if (cloc_count_file(path, language, &lx, run->dedupe, run->max_size))
+            cloc_add(run, lx.language - languages, lx.blank, lx.comment, lx.code);
+        return;
+    }
+
+    if (stat(path, &st) == -1 || (run->max_size > 0 && st.st_size > run->max_size))
+        return;
+    struct cloc_cached *e = cloc_cache_slot(path);
+    if (!cloc_cache_fresh(e, &st)) {
+        if (e->path == NULL) {
+            e->path = strdup(path);
+            cloc_cache_used++;
+        }
+        e->dev = st.st_dev;
+        e->ino = st.st_ino;
+        e->size = st.st_size;
+        e->mtime = st.st_mtim;
+        e->ctime = st.st_ctim;
+        e->language = -1;
+        if (cloc_count_file(path, language, &lx, NULL, 0)) {
+            e->language = lx.language - languages;
+            e->blank = lx.blank;
+            e->comment = lx.comment;
+            e->code = lx.code;
+        }
+    }
+    if (e->language != -1)
+        cloc_add(run, e->language, e->blank, e->comment, e->code);
+}
+
+//parse a size such as 512, 64K or 2M
+off_t parse_size(const char *s) {
+    char *end;
+    errno = 0;
+    long long n = strtoll(s, &end, 10);
+    if (errno || n < 0 || end == s)
+        return -1;
+    switch (*end) {
+    case 'k': case 'K': n <<= 10; end++; break;
+    case 'm': case 'M': n <<= 20; end++; break;
+    case 'g': case 'G': n <<= 30; end++; break;
+    }
+    return *end == '\0' ? (off_t)n : -1;
+}
+
+int compare_info_code(const void *a, const void *b) {
+    const struct Info *x = a, *y = b;
+    if (x->code != y->code)
+        return y->code - x->code > 0 ? 1 : -1;
+    return strcmp(x->name, y->name);
+}
+
+#define CLOC_MAX_SIZE (100 << 20)
+
+/**
+ * cloc [--dedupe] [--exclude-dir a,b] [--max-size SIZE] [--no-ignore] [dir]
+ * With --dedupe, files whose contents were already counted are skipped.
+ * Files over --max-size (100M unless given, 0 for no limit) are skipped
+ * and .gitignore/.clocignore rules are honoured unless --no-ignore.
+ */
+int cloc(struct command_t *command) {
+    const char *drc = NULL;
+    bool dedupe = false;
+    struct walker w;
+    struct cloc_run run = {.max_size = CLOC_MAX_SIZE};
+
+    walker_init(&w);
+    for (int i = 1; command->args[i]; i++) {
+        char *arg = command->args[i];
+        if (strcmp(arg, "--dedupe") == 0) {
+            dedupe = true;
+        } else if (strcmp(arg, "--no-ignore") == 0) {
+            w.use_ignore_files = false;
+        } else if (strcmp(arg, "--exclude-dir") == 0 && command->args[i + 1]) {
+            walker_exclude(&w, command->args[++i]);
+        } else if (strcmp(arg, "--max-size") == 0 && command->args[i + 1] &&
+                   (run.max_size = parse_size(command->args[i + 1])) >= 0) {
+            i++;
+        } else if (drc == NULL && arg[0] != '-') {
+            drc = arg;
+        } else {
+            printf("Usage: cloc [--dedupe] [--exclude-dir a,b] [--max-size SIZE] [--no-ignore] [dir]\n");
+            walker_free(&w);
+            return 1;
+        }
+    }
+    if (drc == NULL) {
+        drc = ".";
+    }
+    registry_init();
+
+    //initializing the structs
+    struct Info info = {" ", 0, 0, 0, 0};
+    struct Info totals[LANGUAGE_COUNT];
+    for (int l = 0; l < LANGUAGE_COUNT; l++) {
+        memset(&totals[l], 0, sizeof(struct Info));
+        snprintf(totals[l].name, sizeof(totals[l].name), "%s", languages[l].name);
+    }
+
+    struct dedupe_table table = {0};
+    run.totals = totals;
+    run.info = &info;
+    run.dedupe = dedupe ? &table : NULL;
+    w.visit_file = cloc_visit_file;
+    w.data = &run;
+    walker_run(&w, drc);
+    walker_free(&w);
+
+    //totals
+    printf("Total number of files in the given directory: %d\n", info.files);
+    printf("\n");
+    printf("Total blank lines %d\n",info.blank);
+    printf("Total comment lines %d\n",info.comment);
+    printf("Total code lines %d\n",info.code);
+    if (dedupe) {
+        printf("Duplicate files skipped: %d\n", table.duplicates);
+        dedupe_free(&table);
+    }
+    printf("\n");
+    //headers, languages with the most code first
+    qsort(totals, LANGUAGE_COUNT, sizeof(struct Info), compare_info_code);
+    printf("%-20s %-10s %-10s %-10s %-10s\n", "Language", "Files", "Blank", "Comment","Code");
+    for (int l = 0; l < LANGUAGE_COUNT; l++) {
+        if (totals[l].files > 0) {
+            printf("%-20s %-10d %-10d %-10d %-10d\n", totals[l].name, totals[l].files,
+                   totals[l].blank, totals[l].comment, totals[l].code);
+        }
+    }
+    return 0;
+}
+
+//custom command 1
+void sandstorm() {
+    char cmd[100];
+    char *url=("https://www.youtube.com/watch?v=y6120QOlsfU");
+#ifdef __APPLE__
+    sprintf(cmd,"open %s", url);
+#elif _WIN32
+    sprintf(cmd,"start %s", url);
+
+#else
+    sprintf(cmd,"xdg-open %s", url);
+#endif
+    system(cmd);
+}
+
+//custom command 2
+/*
+ * strfile(8) style fortune databases: a text file of entries separated by
+ * "%" lines, next to a .dat index (big-endian header and one offset per
+ * entry). Both are mapped, so picking an entry is an array lookup and a
+ * scan to the next delimiter line. Only the start offsets are used, so
+ * the shuffled or sorted indexes of strfile -r and -o work as well. A
+ * missing or stale index is built once from the mapped text and written
+ * back when the directory allows it.
+ */
+#define STRFILE_VERSION 2
+#define STR_ROTATED 0x4
+
+struct strfile_header {
+    uint32_t version;
+    uint32_t numstr;
+    uint32_t longlen;
+    uint32_t shortlen;
+    uint32_t flags;
+    char delim;
+    char pad[3];
+};
+
+struct fortune_db {
+    char *path;
+    const char *data; // mapped text
+    size_t size;
+    uint32_t count;
+    const uint32_t *offsets; // count + 1 big-endian offsets
+    void *index_map; // mapped .dat, or NULL when offsets were built here
+    size_t index_size;
+    bool rotated;
+    char delim;
+    struct stat text_st, index_st; // what was mapped, to notice changes
+};
+
+//databases of the current MISHELL_FORTUNE_PATH, loaded on first use
+struct fortune_db *fortune_dbs = NULL;
+int fortune_db_count = 0;
+uint64_t *fortune_weights = NULL; // running sum of the data sizes
+char *fortune_loaded_for = NULL;
+
+/**
+ * Index the entries of a text mapped in memory and try to save it as
+ * path.dat for the next time
+ */
+uint32_t *fortune_build_index(const char *path, const char *data, size_t size, uint32_t *count) {
+    size_t cap = 1024;
+    uint32_t *offsets = malloc(cap * sizeof(uint32_t));
+    uint32_t n = 0, longlen = 0, shortlen = UINT32_MAX;
+    size_t start = 0;
+
+    while (start < size) {
+        // the entry runs up to the next "%" line
+        size_t end = start;
+        const char *p = data + start;
+        while ((p = memchr(p, '\n', size - (p - data))) != NULL) {
+            if (p + 1 < data + size && p[1] == '%' && (p + 2 == data + size || p[2] == '\n'))
+                break;
+            p++;
+        }
+        end = p ? (size_t)(p - data) + 1 : size;
+
+        if (end > start && !(end - start == 1 && data[start] == '\n')) {
+            if (n + 2 > cap) {
+                cap *= 2;
+                offsets = realloc(offsets, cap * sizeof(uint32_t));
+            }
+            offsets[n++] = htonl(start);
+            if (end - start > longlen)
+                longlen = end - start;
+            if (end - start < shortlen)
+                shortlen = end - start;
+        }
+        start = p ? end + 2 : size; // skip the "%\n" line
+    }
+    offsets[n] = htonl(size);
+    *count = n;
+
+    // written aside and renamed, a reader never maps half an index
+    char dat[PATH_MAX], tmp[PATH_MAX + 32];
+    snprintf(dat, sizeof(dat), "%s.dat", path);
+    snprintf(tmp, sizeof(tmp), "%s.%d", dat, (int)getpid());
+    FILE *file = fopen(tmp, "w");
+    if (file != NULL) {
+        struct strfile_header header = {htonl(STRFILE_VERSION), htonl(n), htonl(longlen),
+                                        htonl(n ? shortlen : 0), 0, '%', {0}};
+        bool written = fwrite(&header, sizeof(header), 1, file) == 1 &&
+                       fwrite(offsets, sizeof(uint32_t), n + 1, file) == n + 1;
+        if (fclose(file) == 0 && written)
+            rename(tmp, dat);
+        else
+            unlink(tmp);
+    }
+    return offsets;
+}
+
+bool fortune_open(const char *path, struct fortune_db *db) {
+    struct stat st, dat_st;
+    char dat[PATH_MAX];
+
+    memset(db, 0, sizeof(*db));
+    int fd = open(path, O_RDONLY);
+    if (fd == -1 || fstat(fd, &st) == -1 || !S_ISREG(st.st_mode) || st.st_size == 0 ||
+        st.st_size > UINT32_MAX) {
+        if (fd != -1)
+            close(fd);
+        return false;
+    }
+    db->data = mmap(NULL, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+    close(fd);
+    if (db->data == MAP_FAILED)
+        return false;
+    db->size = st.st_size;
+    db->path = strdup(path);
+    db->delim = '%';
+    db->text_st = st;
+
+    // an index older than the text, or ending somewhere else, is stale
+    snprintf(dat, sizeof(dat), "%s.dat", path);
+    fd = open(dat, O_RDONLY);
+    if (fd != -1 && fstat(fd, &dat_st) == 0 && dat_st.st_mtime >= st.st_mtime &&
+        (size_t)dat_st.st_size >= sizeof(struct strfile_header)) {
+        void *map = mmap(NULL, dat_st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+        if (map != MAP_FAILED) {
+            const struct strfile_header *header = map;
+            uint32_t n = ntohl(header->numstr);
+            const uint32_t *offsets = (const uint32_t *)(header + 1);
+            if ((size_t)dat_st.st_size >= sizeof(*header) + ((size_t)n + 1) * sizeof(uint32_t) &&
+                ntohl(offsets[n]) == st.st_size) {
+                db->index_map = map;
+                db->index_size = dat_st.st_size;
+                db->count = n;
+                db->offsets = offsets;
+                db->rotated = ntohl(header->flags) & STR_ROTATED;
+                db->delim = header->delim;
+                db->index_st = dat_st;
+            } else {
+                munmap(map, dat_st.st_size);
+            }
+        }
+    }
+    if (fd != -1)
+        close(fd);
+
+    if (db->offsets == NULL)
+        db->offsets = fortune_build_index(path, db->data, db->size, &db->count);
+    return db->count > 0;
+}
+
+/**
+ * Check the mapped text and index against the files now on disk. A file
+ * truncated under a mapping raises SIGBUS when the lost pages are read.
+ * @return true if either was rewritten, truncated or replaced
+ */
+bool fortune_changed(const struct fortune_db *db) {
+    struct stat st;
+    char dat[PATH_MAX];
+
+    if (stat(db->path, &st) == -1 || st.st_ino != db->text_st.st_ino ||
+        st.st_dev != db->text_st.st_dev || st.st_size != db->text_st.st_size ||
+        st.st_mtim.tv_sec != db->text_st.st_mtim.tv_sec ||
+        st.st_mtim.tv_nsec != db->text_st.st_mtim.tv_nsec)
+        return true;
+    if (db->index_map == NULL)
+        return false;
+    snprintf(dat, sizeof(dat), "%s.dat", db->path);
+    return stat(dat, &st) == -1 || st.st_ino != db->index_st.st_ino ||
+           st.st_dev != db->index_st.st_dev || st.st_size != db->index_st.st_size ||
+           st.st_mtim.tv_sec != db->index_st.st_mtim.tv_sec ||
+           st.st_mtim.tv_nsec != db->index_st.st_mtim.tv_nsec;
+}
+
+void fortune_close_all() {
+    for (int i = 0; i < fortune_db_count; i++) {
+        struct fortune_db *db = &fortune_dbs[i];
+        munmap((void *)db->data, db->size);
+        if (db->index_map)
+            munmap(db->index_map, db->index_size);
+        else
+            free((void *)db->offsets);
+        free(db->path);
+    }
+    free(fortune_dbs);
+    free(fortune_weights);
+    free(fortune_loaded_for);
+    fortune_dbs = NULL;
+    fortune_weights = NULL;
+    fortune_loaded_for = NULL;
+    fortune_db_count = 0;
+}
+
+void fortune_add(const char *path) {
+    struct fortune_db db;
+    if (!fortune_open(path, &db)) {
+        if (db.data && db.data != MAP_FAILED)
+            munmap((void *)db.data, db.size);
+        if (db.index_map)
+            munmap(db.index_map, db.index_size);
+        else
+            free((void *)db.offsets);
+        free(db.path);
+        return;
+    }
+    fortune_dbs = realloc(fortune_dbs, (fortune_db_count + 1) * sizeof(struct fortune_db));
+    fortune_weights = realloc(fortune_weights, (fortune_db_count + 1) * sizeof(uint64_t));
+    fortune_weights[fortune_db_count] = db.size + (fortune_db_count ? fortune_weights[fortune_db_count - 1] : 0);
+    fortune_dbs[fortune_db_count++] = db;
+}
+
+/**
+ * Map every database of a colon separated list of files and directories
+ */
+void fortune_load(const char *list) {
+    if (fortune_loaded_for && strcmp(fortune_loaded_for, list) == 0) {
+        int i = 0;
+        while (i < fortune_db_count && !fortune_changed(&fortune_dbs[i]))
+            i++;
+        if (i == fortune_db_count)
+            return;
+    }
+    fortune_close_all();
+    fortune_loaded_for = strdup(list);
+
+    char *copy = strdup(list), *save;
+    for (char *path = strtok_r(copy, ":", &save); path; path = strtok_r(NULL, ":", &save)) {
+        struct stat st;
+        if (stat(path, &st) == 0 && S_ISDIR(st.st_mode)) {
+            struct dir_listing *d = dircache_get(path);
+            for (int i = 0; d && i < d->count; i++) {
+                const char *name = d->names + d->offsets[i];
+                const char *ext = strrchr(name, '.');
+                if (name[0] == '.' || (ext && (strcmp(ext, ".dat") == 0 || strcmp(ext, ".u8") == 0)))
+                    continue;
+                char file[PATH_MAX];
+                snprintf(file, sizeof(file), "%s/%s", path, name);
+                fortune_add(file);
+            }
+        } else {
+            fortune_add(path);
+        }
+    }
+    free(copy);
+}
+
+const char *const builtin_fortunes[] = {"You will encounter a coding bug so bizarre, you'll start to wonder if your computer is possessed by a mischievous spirit.\n", "Your future holds a plethora of keyboard shortcuts that will make you feel like a wizard of the digital realm.\n", "In your future, you will finally solve a programming problem that's been driving you crazy - just in time for it to become obsolete.\n",
+                         "Your computer will crash at the most inconvenient time possible, reminding you that technology truly has a sense of humor.\n", "The code you write today will run perfectly - but only on the machine you wrote it on. Good luck :).\n", "\"In the near future, you will discover the joys of pointer arithmetic in C. Don't worry, it's not as painful as it sounds.\n",
+                         "You will encounter a bug in your C code that will make you question the fundamental laws of computer science.\n", "Your mastery of C will impress even the most seasoned programmers, earning you the nickname 'C-sar' among your peers.\n", "Your code will compile without errors, but when you run it, you'll be greeted with a delightful surprise: a segfault!\n",
+                         "You will spend hours debugging a single line of code in C, only to find that the problem was caused by a misplaced semicolon.\n", "In the near future, you will experience the joy of watching an operating system update progress bar move at an excruciatingly slow pace\n", "You will encounter a mysterious error message while working with your operating system, leaving you wondering if the Matrix has just glitched.\n",
+                         "Your future holds a visit to the dreaded Blue Screen of Death. Don't worry, it happens to the best of us. \n"," You will discover a hidden Easter egg in your operating system that will make you question whether the developers have a sense of humor or not.\n","Your operating system will suddenly decide to update itself in the middle of an important task, leaving you with a newfound appreciation for manual updates.\n","You will encounter the Linux terminal for the first time and feel like you've been transported to a world of endless possibilities.\n",
+                         "Your future holds a late-night session of compiling and installing packages from source code, leaving you feeling like a true Linux guru.\n", "You will experience the satisfaction of solving a complex problem using Linux command-line tools, and wonder how you ever lived without them.\n", "Your Linux system will crash unexpectedly, but fear not - with the power of the command line, you'll be able to diagnose and fix the issue in no time.\n", "You will discover the joys of customizing your Linux desktop environment, creating a unique setup that reflects your personality and style\n",
+                         "You will become so proficient in Vim that you'll start editing text in your dreams with HJKL\n","In the future, you'll accidentally activate Vim's 'delete everything' mode and be left wondering if your document ever existed.\n","You'll become so comfortable using Vim that you'll start seeing regular text editors as mere toys.\n","You will encounter a fellow Vim user and bond over your mutual love for efficient editing and obscure keyboard shortcuts.\n","Your future holds a moment of panic when you realize you can't exit Vim, but fear not - Google and the Vim community will come to your rescue.\n"
+};
+
+/**
+ * fortune [files or directories...]
+ * Without arguments the databases come from MISHELL_FORTUNE_PATH, or the
+ * built-in fortunes are used. A database is picked with a probability
+ * proportional to its size, then one of its entries uniformly.
+ */
+int fortune(struct command_t *command) {
+    rng_init();
+
+    struct strbuf list = {0};
+    for (int i = 1; command->args[i]; i++) {
+        if (i > 1)
+            strbuf_puts(&list, ":");
+        strbuf_puts(&list, command->args[i]);
+    }
+    if (list.len == 0 && getenv("MISHELL_FORTUNE_PATH"))
+        strbuf_puts(&list, getenv("MISHELL_FORTUNE_PATH"));
+
+    if (list.len == 0) {
+        int count = sizeof(builtin_fortunes) / sizeof(builtin_fortunes[0]);
+        printf("%s", builtin_fortunes[rng_range(rng_next(), count)]);
+        return 0;
+    }
+
+    fortune_load(list.data);
+    free(list.data);
+    if (fortune_db_count == 0) {
+        fprintf(stderr, "-%s: fortune: no fortune databases found\n", sysname);
+        return 1;
+    }
+
+    // binary search of the running size sums
+    uint64_t r = rng_range(rng_next(), fortune_weights[fortune_db_count - 1]);
+    int lo = 0, hi = fortune_db_count - 1;
+    while (lo < hi) {
+        int mid = (lo + hi) / 2;
+        if (fortune_weights[mid] > r)
+            hi = mid;
+        else
+            lo = mid + 1;
+    }
+
+    struct fortune_db *db = &fortune_dbs[lo];
+    uint32_t i = rng_range(rng_next(), db->count);
+    uint32_t start = ntohl(db->offsets[i]);
+    if (start >= db->size)
+        return 1;
+
+    // the entry runs up to the next delimiter line, whatever the order of
+    // the offsets or the entries the index left out
+    const char *text = db->data + start, *end = db->data + db->size;
+    size_t len = 0;
+    for (const char *line = text; line < end;) {
+        if (line[0] == db->delim && (line + 1 == end || line[1] == '\n'))
+            break;
+        const char *nl = memchr(line, '\n', end - line);
+        line = nl ? nl + 1 : end;
+        len = line - text;
+    }
+
+    if (db->rotated) {
+        for (size_t j = 0; j < len; j++) {
+            char c = text[j];
+            if (c >= 'a' && c <= 'z')
+                c = 'a' + (c - 'a' + 13) % 26;
+            else if (c >= 'A' && c <= 'Z')
+                c = 'A' + (c - 'A' + 13) % 26;
+            putchar(c);
+        }
+    } else {
+        fwrite(text, 1, len, stdout);
+    }
+    return 0;
+}
+
+void psvis(pid_t pid) { //add output file
+
+    struct ast_node* get_ast_for_pid(pid);
+
+}
+
+/**
+ * Print the escape sequence that follows a backslash (echo -e, printf)
+ * @param  s text after the backslash
+ * @return   characters consumed, or -1 for \c (stop printing)
+ */
+int print_escape(const char *s) {
+	int n = 0, value = 0;
+
+	switch (*s) {
+	case 'a': putchar('\a'); return 1;
+	case 'b': putchar('\b'); return 1;
+	case 'e': putchar(27); return 1;
+	case 'f': putchar('\f'); return 1;
+	case 'n': putchar('\n'); return 1;
+	case 'r': putchar('\r'); return 1;
+	case 't': putchar('\t'); return 1;
+	case 'v': putchar('\v'); return 1;
+	case '\\': putchar('\\'); return 1;
+	case 'c': return -1;
+	case '\0': putchar('\\'); return 0;
+	}
+
+	if (*s >= '0' && *s <= '7') {
+		// \0nnn (echo) or \nnn (printf)
+		int max = *s == '0' ? 4 : 3;
+		while (n < max && s[n] >= '0' && s[n] <= '7')
+			value = value * 8 + (s[n++] - '0');
+		putchar(value);
+		return n;
+	}
+
+	putchar('\\');
+	putchar(*s);
+	return 1;
+}
+
+//echo [-neE] [args...]
+int builtin_echo(struct command_t *command) {
+	bool newline = true, escapes = false;
+	int i = 1;
+
+	for (; command->args[i] && command->args[i][0] == '-' && command->args[i][1]; i++) {
+		const char *opt = command->args[i] + 1;
+		if (strspn(opt, "neE") != strlen(opt))
+			break; // not an option, print it
+		for (; *opt; opt++) {
+			if (*opt == 'n')
+				newline = false;
+			else
+				escapes = *opt == 'e';
+		}
+	}
+
+	for (int first = i; command->args[i]; i++) {
+		if (i > first)
+			putchar(' ');
+		if (!escapes) {
+			fputs(command->args[i], stdout);
+			continue;
+		}
+		for (const char *p = command->args[i]; *p; p++) {
+			if (*p != '\\') {
+				putchar(*p);
+				continue;
+			}
+			int n = print_escape(p + 1);
+			if (n == -1)
+				return 0;
+			p += n;
+		}
+	}
+
+	if (newline)
+		putchar('\n');
+	return 0;
+}
+
+/**
+ * Numeric printf argument, 'c gives the code of the character c
+ */
+long long printf_number(const char *arg, bool *error) {
+	if (arg[0] == '\'' || arg[0] == '"')
+		return (unsigned char)arg[1];
+
+	char *end;
+	errno = 0;
+	long long value = strtoll(arg, &end, 0);
+	if (*arg == '\0')
+		return 0;
+	if (*end != '\0' || errno != 0) {
+		fprintf(stderr, "-%s: printf: %s: invalid number\n", sysname, arg);
+		*error = true;
+	}
+	return value;
+}
+
+//printf format [args...], the format is reused while arguments remain
+int builtin_printf(struct command_t *command) {
+	if (command->args[1] == NULL) {
+		fprintf(stderr, "-%s: printf: usage: printf format [arguments]\n", sysname);
+		return 2;
+	}
+
+	const char *format = command->args[1];
+	char **argv = command->args + 2;
+	bool error = false;
+
+	do {
+		char **start = argv;
+		for (const char *p = format; *p; p++) {
+			if (*p == '\\') {
+				int n = print_escape(p + 1);
+				if (n == -1)
+					return error;
+				p += n;
+				continue;
+			}
+			if (*p != '%') {
+				putchar(*p);
+				continue;
+			}
+			if (p[1] == '%') {
+				putchar('%');
+				p++;
+				continue;
+			}
+
+			// copy the conversion spec, leaving room for the ll modifier
+			char spec[64];
+			int len = 0;
+			spec[len++] = *p++;
+			while (*p && strchr("-+ #0", *p) && len < 40)
+				spec[len++] = *p++;
+			while (*p && (isdigit((unsigned char)*p) || *p == '.') && len < 40)
+				spec[len++] = *p++;
+			if (*p == '\0')
+				break;
+
+			const char *arg = *argv ? *argv++ : "";
+			switch (*p) {
+			case 'd': case 'i':
+				spec[len++] = 'l';
+				spec[len++] = 'l';
+				spec[len++] = *p;
+				spec[len] = '\0';
+				printf(spec, printf_number(arg, &error));
+				break;
+			case 'o': case 'u': case 'x': case 'X':
+				spec[len++] = 'l';
+				spec[len++] = 'l';
+				spec[len++] = *p;
+				spec[len] = '\0';
+				printf(spec, (unsigned long long)printf_number(arg, &error));
+				break;
+			case 'e': case 'E': case 'f': case 'F': case 'g': case 'G':
+				spec[len++] = *p;
+				spec[len] = '\0';
+				printf(spec, *arg ? strtod(arg, NULL) : 0.0);
+				break;
+			case 'c':
+				if (*arg)
+					putchar(*arg);
+				break;
+			case 's':
+				spec[len++] = 's';
+				spec[len] = '\0';
+				printf(spec, arg);
+				break;
+			case 'b':
+				for (const char *q = arg; *q; q++) {
+					if (*q != '\\') {
+						putchar(*q);
+						continue;
+					}
+					int n = print_escape(q + 1);
+					if (n == -1)
+						return error;
+					q += n;
+				}
+				break;
+			default:
+				fprintf(stderr, "-%s: printf: %%%c: invalid directive\n", sysname, *p);
+				return 1;
+			}
+		}
+		if (argv == start)
+			break; // format consumed nothing, do not loop forever
+	} while (*argv);
+
+	return error;
+}
+
+//recursive descent state for test
+struct test_state {
+	char **argv;
+	int argc;
+	int pos;
+	bool error;
+};
+
+bool test_or(struct test_state *t);
+
+bool test_integer(struct test_state *t, const char *s, long long *value) {
+	char *end;
+	errno = 0;
+	*value = strtoll(s, &end, 10);
+	while (isspace((unsigned char)*end))
+		end++;
+	if (*s == '\0' || *end != '\0' || errno != 0) {
+		fprintf(stderr, "-%s: test: %s: integer expression expected\n", sysname, s);
+		t->error = true;
+		return false;
+	}
+	return true;
+}
+
+bool test_unary(const char *op, const char *arg) {
+	struct stat st;
+
+	if (strcmp(op, "-n") == 0)
+		return arg[0] != '\0';
+	if (strcmp(op, "-z") == 0)
+		return arg[0] == '\0';
+	if (strcmp(op, "-t") == 0)
+		return isatty(atoi(arg));
+	if (strcmp(op, "-r") == 0)
+		return access(arg, R_OK) == 0;
+	if (strcmp(op, "-w") == 0)
+		return access(arg, W_OK) == 0;
+	if (strcmp(op, "-x") == 0)
+		return access(arg, X_OK) == 0;
+	if (strcmp(op, "-h") == 0 || strcmp(op, "-L") == 0)
+		return lstat(arg, &st) == 0 && S_ISLNK(st.st_mode);
+
+	if (stat(arg, &st) != 0)
+		return false;
+	switch (op[1]) {
+	case 'e': return true;
+	case 'f': return S_ISREG(st.st_mode);
+	case 'd': return S_ISDIR(st.st_mode);
+	case 'b': return S_ISBLK(st.st_mode);
+	case 'c': return S_ISCHR(st.st_mode);
+	case 'p': return S_ISFIFO(st.st_mode);
+	case 'S': return S_ISSOCK(st.st_mode);
+	case 's': return st.st_size > 0;
+	case 'g': return (st.st_mode & S_ISGID) != 0;
+	case 'u': return (st.st_mode & S_ISUID) != 0;
+	case 'k': return (st.st_mode & S_ISVTX) != 0;
+	case 'O': return st.st_uid == geteuid();
+	case 'G': return st.st_gid == getegid();
+	}
+	return false;
+}
+
+bool is_test_unary(const char *op) {
+	return op[0] == '-' && op[1] && op[2] == '\0' && strchr("bcdefghLkprsStuwxOGnz", op[1]);
+}
+
+bool is_test_binary(const char *op) {
+	const char *ops[] = {"=", "==", "!=", "<", ">", "-eq", "-ne", "-lt", "-le",
+						 "-gt", "-ge", "-nt", "-ot", "-ef"};
+	for (size_t i = 0; i < sizeof(ops) / sizeof(ops[0]); i++) {
+		if (strcmp(op, ops[i]) == 0)
+			return true;
+	}
+	return false;
+}
+
+bool test_binary(struct test_state *t, const char *a, const char *op, const char *b) {
+	struct stat sa, sb;
+	long long x, y;
+
+	if (strcmp(op, "=") == 0 || strcmp(op, "==") == 0)
+		return strcmp(a, b) == 0;
+	if (strcmp(op, "!=") == 0)
+		return strcmp(a, b) != 0;
+	if (strcmp(op, "<") == 0)
+		return strcmp(a, b) < 0;
+	if (strcmp(op, ">") == 0)
+		return strcmp(a, b) > 0;
+
+	if (strcmp(op, "-nt") == 0 || strcmp(op, "-ot") == 0 || strcmp(op, "-ef") == 0) {
+		bool ha = stat(a, &sa) == 0, hb = stat(b, &sb) == 0;
+		if (op[1] == 'e')
+			return ha && hb && sa.st_dev == sb.st_dev && sa.st_ino == sb.st_ino;
+		if (op[1] == 'n')
+			return ha && (!hb || sa.st_mtime > sb.st_mtime);
+		return hb && (!ha || sa.st_mtime < sb.st_mtime);
+	}
+
+	if (!test_integer(t, a, &x) || !test_integer(t, b, &y))
+		return false;
+	if (strcmp(op, "-eq") == 0)
+		return x == y;
+	if (strcmp(op, "-ne") == 0)
+		return x != y;
+	if (strcmp(op, "-lt") == 0)
+		return x < y;
+	if (strcmp(op, "-le") == 0)
+		return x <= y;
+	if (strcmp(op, "-gt") == 0)
+		return x > y;
+	return x >= y;
+}
+
+bool test_primary(struct test_state *t) {
+	if (t->pos >= t->argc) {
+		t->error = true;
+		return false;
+	}
+
+	char **argv = t->argv + t->pos;
+	int left = t->argc - t->pos;
+
+	if (left >= 3 && is_test_binary(argv[1])) {
+		t->pos += 3;
+		return test_binary(t, argv[0], argv[1], argv[2]);
+	}
+	if (strcmp(argv[0], "(") == 0 && left >= 2) {
+		t->pos++;
+		bool value = test_or(t);
+		if (t->pos >= t->argc || strcmp(t->argv[t->pos], ")") != 0) {
+			fprintf(stderr, "-%s: test: missing ')'\n", sysname);
+			t->error = true;
+			return false;
+		}
+		t->pos++;
+		return value;
+	}
+	if (left >= 2 && is_test_unary(argv[0])) {
+		t->pos += 2;
+		return test_unary(argv[0], argv[1]);
+	}
+	t->pos++;
+	return argv[0][0] != '\0';
+}
+
+bool test_not(struct test_state *t) {
+	if (t->pos < t->argc - 1 && strcmp(t->argv[t->pos], "!") == 0) {
+		t->pos++;
+		return !test_not(t);
+	}
+	return test_primary(t);
+}
+
+bool test_and(struct test_state *t) {
+	bool value = test_not(t);
+	while (t->pos < t->argc && strcmp(t->argv[t->pos], "-a") == 0) {
+		t->pos++;
+		value = test_not(t) && value;
+	}
+	return value;
+}
+
+bool test_or(struct test_state *t) {
+	bool value = test_and(t);
+	while (t->pos < t->argc && strcmp(t->argv[t->pos], "-o") == 0) {
+		t->pos++;
+		value = test_and(t) || value;
+	}
+	return value;
+}
+
+//test expr / [ expr ]
+int builtin_test(struct command_t *command) {
+	struct test_state t = {command->args + 1, command->arg_count - 2, 0, false};
+
+	if (strcmp(command->name, "[") == 0) {
+		if (t.argc == 0 || strcmp(t.argv[t.argc - 1], "]") != 0) {
+			fprintf(stderr, "-%s: [: missing ']'\n", sysname);
+			return 2;
+		}
+		t.argc--;
+	}
+	if (t.argc == 0)
+		return 1;
+
+	bool value = test_or(&t);
+	if (!t.error && t.pos != t.argc) {
+		fprintf(stderr, "-%s: test: %s: unexpected argument\n", sysname, t.argv[t.pos]);
+		t.error = true;
+	}
+	if (t.error)
+		return 2;
+	return value ? 0 : 1;
+}
+
+int builtin_true(struct command_t *command) {
+	(void)command;
+	return 0;
+}
+
+int builtin_false(struct command_t *command) {
+	(void)command;
+	return 1;
+}
+
+int builtin_pwd(struct command_t *command) {
+	(void)command;
+	char *cwd = getcwd(NULL, 0);
+	if (cwd == NULL) {
+		fprintf(stderr, "-%s: pwd: %s\n", sysname, strerror(errno));
+		return 1;
+	}
+	puts(cwd);
+	free(cwd);
+	return 0;
+}
+
+//builtins that always run inside the shell process, even as pipeline
+//stages, so scripts made of them never fork. None of them reads stdin.
+struct core_builtin {
+	const char *name;
+	int (*run)(struct command_t *command); // returns the exit status
+};
+
+struct core_builtin core_builtins[] = {
+	{"echo", builtin_echo},
+	{"printf", builtin_printf},
+	{"test", builtin_test},
+	{"[", builtin_test},
+	{"true", builtin_true},
+	{"false", builtin_false},
+	{"pwd", builtin_pwd},
+};
+
+struct core_builtin *find_core_builtin(const char *name) {
+	for (size_t i = 0; i < sizeof(core_builtins) / sizeof(core_builtins[0]); i++) {
+		if (strcmp(name, core_builtins[i].name) == 0)
+			return &core_builtins[i];
+	}
+	return NULL;
+}
+
+/**
+ * Build a command from an argument vector (the part after "--" of memo,
+ * watch-run, ...)
+ * @param  argv NULL terminated
+ * @return      a command to release with free_command()
+ */
+struct command_t *command_from_args(char **argv) {
+	struct command_t *command = calloc(1, sizeof(struct command_t));
+	int n = 0;
+	while (argv[n])
+		n++;
+
+	command->name = strdup(n ? argv[0] : "");
+	command->arg_count = n + 1;
+	command->args = malloc((n + 1) * sizeof(char *));
+	for (int i = 0; i < n; i++)
+		command->args[i] = strdup(argv[i]);
+	command->args[n] = NULL;
+	return command;
+}
+
+void wait_child(pid_t pid);
+void prepare_suggestions(struct command_t *command);
+
+//copy a whole file to a descriptor, in the kernel when possible
+int copy_file_to_fd(int in, int out) {
+	struct stat st;
+	if (fstat(in, &st) == -1)
+		return -1;
+
+	off_t offset = 0;
+	while (offset < st.st_size) {
+		ssize_t n = sendfile(out, in, &offset, st.st_size - offset);
+		if (n == -1 && errno == EINTR)
+			continue;
+		if (n <= 0)
+			break;
+	}
+	if (offset == st.st_size)
+		return 0;
+
+	// sendfile refused the descriptor pair, plain copy of the rest
+	char buf[65536];
+	ssize_t n;
+	lseek(in, offset, SEEK_SET);
+	while ((n = read(in, buf, sizeof(buf))) > 0) {
+		for (ssize_t done = 0; done < n;) {
+			ssize_t w = write(out, buf + done, n - done);
+			if (w == -1 && errno == EINTR)
+				continue;
+			if (w <= 0)
+				return -1;
+			done += w;
+		}
+	}
+	return n == 0 ? 0 : -1;
+}
+
+/**
+ * memo [--ttl S] [--env NAME]... -- cmd args
+ * Cache the stdout of a deterministic command that exits with 0. Entries
+ * live in $MISHELL_MEMO_DIR (default ~/.mishell_memo), named by a hash of
+ * the argv, the cwd, PATH/LANG/LC_ALL plus any --env variables, and the
+ * (dev, inode, mtime, size) of the file given with '<'. Hits are copied
+ * to stdout with sendfile() without running anything.
+ */
+int memo(struct command_t *command) {
+	long ttl = 0;
+	const char *env_names[64] = {"PATH", "LANG", "LC_ALL"};
+	int env_count = 3, i;
+
+	for (i = 1; command->args[i]; i++) {
+		if (strcmp(command->args[i], "--") == 0) {
+			i++;
+			break;
+		}
+		if (strcmp(command->args[i], "--ttl") == 0 && command->args[i + 1]) {
+			ttl = atol(command->args[++i]);
+		} else if (strcmp(command->args[i], "--env") == 0 && command->args[i + 1] && env_count < 64) {
+			env_names[env_count++] = command->args[++i];
+		} else {
+			break;
+		}
+	}
+	if (command->args[i] == NULL) {
+		fprintf(stderr, "-%s: memo: usage: memo [--ttl S] [--env NAME]... -- cmd args\n", sysname);
+		return 2;
+	}
+	char **argv = command->args + i;
+
+	// everything the output may depend on
+	struct strbuf key = {0};
+	for (int j = 0; argv[j]; j++) {
+		strbuf_puts(&key, argv[j]);
+		strbuf_append(&key, "\x1f", 1);
+	}
+	char *cwd = getcwd(NULL, 0);
+	strbuf_puts(&key, "\ncwd=");
+	strbuf_puts(&key, cwd ? cwd : "");
+	free(cwd);
+	for (int j = 0; j < env_count; j++) {
+		const char *value = getenv(env_names[j]);
+		strbuf_puts(&key, "\n");
+		strbuf_puts(&key, env_names[j]);
+		strbuf_puts(&key, value ? "=" : "");
+		strbuf_puts(&key, value ? value : "");
+	}
+	if (command->redirects[0]) {
+		struct stat st;
+		char input[256];
+		if (stat(command->redirects[0], &st) == 0) {
+			snprintf(input, sizeof(input), "\ninput=%lu:%lu:%ld.%09ld:%lld",
+					 (unsigned long)st.st_dev, (unsigned long)st.st_ino,
+					 (long)st.st_mtim.tv_sec, st.st_mtim.tv_nsec, (long long)st.st_size);
+			strbuf_puts(&key, input);
+		}
+	}
+	strbuf_puts(&key, "\n");
+
+	char dir[PATH_MAX], out_path[PATH_MAX + 32], meta_path[PATH_MAX + 32];
+	const char *store = getenv("MISHELL_MEMO_DIR");
+	if (store)
+		snprintf(dir, sizeof(dir), "%s", store);
+	else
+		snprintf(dir, sizeof(dir), "%s/.mishell_memo", getenv("HOME") ? getenv("HOME") : "/tmp");
+	mkdir(dir, 0700);
+	snprintf(out_path, sizeof(out_path), "%s/%016lx.out", dir, hash_string(key.data));
+	snprintf(meta_path, sizeof(meta_path), "%s/%016lx.meta", dir, hash_string(key.data));
+
+	// hit: the meta file holds the status and the full key (collisions)
+	struct stat st;
+	FILE *meta = fopen(meta_path, "r");
+	if (meta != NULL && fstat(fileno(meta), &st) == 0 &&
+		(ttl <= 0 || time(NULL) - st.st_mtime < ttl)) {
+		int status;
+		char *stored = malloc(key.len + 2);
+		size_t n = 0;
+		if (fscanf(meta, "%d\n", &status) == 1)
+			n = fread(stored, 1, key.len + 1, meta);
+		int out = open(out_path, O_RDONLY);
+		if (n == key.len && memcmp(stored, key.data, key.len) == 0 && out != -1) {
+			fflush(stdout);
+			copy_file_to_fd(out, STDOUT_FILENO);
+			close(out);
+			fclose(meta);
+			free(stored);
+			free(key.data);
+			return status;
+		}
+		if (out != -1)
+			close(out);
+		free(stored);
+	}
+	if (meta != NULL)
+		fclose(meta);
+
+	// miss: run with stdout into a temp file, then publish with renames
+	char tmp_out[PATH_MAX + 48], tmp_meta[PATH_MAX + 48];
+	snprintf(tmp_out, sizeof(tmp_out), "%s.%d", out_path, (int)getpid());
+	snprintf(tmp_meta, sizeof(tmp_meta), "%s.%d", meta_path, (int)getpid());
+	int out = open(tmp_out, O_RDWR | O_CREAT | O_TRUNC, 0600);
+	if (out == -1) {
+		fprintf(stderr, "-%s: memo: %s: %s\n", sysname, tmp_out, strerror(errno));
+		free(key.data);
+		return 1;
+	}
+
+	struct command_t *inner = command_from_args(argv);
+	prepare_suggestions(inner);
+	fflush(stdout);
+	pid_t pid = fork();
+	if (pid == 0) {
+		dup2(out, STDOUT_FILENO);
+		close(out);
+		exec_command(inner);
+	}
+	int saved_status = last_status;
+	last_status = -1; // left alone if the child cannot be waited for
+	if (pid != -1)
+		wait_child(pid);
+	int status = pid == -1 || last_status == -1 ? 1 : last_status;
+	// only a clean exit is published: a failure (command not found, a
+	// signal, a full disk) may not happen on the next run
+	bool publish = pid != -1 && last_status == 0;
+	last_status = saved_status;
+	free_command(inner);
+
+	meta = publish ? fopen(tmp_meta, "w") : NULL;
+	if (meta != NULL) {
+		fprintf(meta, "%d\n", status);
+		fwrite(key.data, 1, key.len, meta);
+		fclose(meta);
+		rename(tmp_out, out_path);
+		rename(tmp_meta, meta_path);
+	} else {
+		unlink(tmp_out);
+	}
+
+	lseek(out, 0, SEEK_SET);
+	copy_file_to_fd(out, STDOUT_FILENO);
+	close(out);
+	free(key.data);
+	return status;
+}
+
+/*
+ * watch-run: rerun a command whenever something below the watched paths
+ * changes. Every directory the walker would enter gets an inotify watch,
+ * so ignored trees cost nothing, and directories created later are added
+ * as they appear. A burst of events is coalesced into a single run once
+ * the tree has been quiet for the debounce interval.
+ */
+#define WATCH_MASK (IN_CLOSE_WRITE | IN_CREATE | IN_DELETE | IN_MOVED_FROM | \
+					IN_MOVED_TO | IN_ATTRIB | IN_DELETE_SELF | IN_MOVE_SELF)
+
+volatile sig_atomic_t watch_interrupted = 0;
+
+void watch_interrupt(int sig) {
+	(void)sig;
+	watch_interrupted = 1;
+}
+
+struct watch {
+	int fd;
+	char **paths; // watched path of each watch descriptor
+	int path_cap;
+	char **roots;
+	int root_count;
+	struct walker walker;
+};
+
+void watch_add(struct watch *watch, const char *path) {
+	int wd = inotify_add_watch(watch->fd, path, WATCH_MASK);
+	if (wd == -1) {
+		if (errno == ENOSPC)
+			fprintf(stderr, "-%s: watch-run: %s: inotify watch limit reached\n", sysname, path);
+		return;
+	}
+	if (wd >= watch->path_cap) {
+		int cap = watch->path_cap ? watch->path_cap : 64;
+		while (cap <= wd)
+			cap *= 2;
+		watch->paths = realloc(watch->paths, cap * sizeof(char *));
+		memset(watch->paths + watch->path_cap, 0, (cap - watch->path_cap) * sizeof(char *));
+		watch->path_cap = cap;
+	}
+	if (watch->paths[wd] == NULL || strcmp(watch->paths[wd], path) != 0) {
+		free(watch->paths[wd]);
+		watch->paths[wd] = strdup(path);
+	}
+}
+
+void watch_visit_dir(struct walker *w, const char *path) {
+	watch_add(w->data, path);
+}
+
+//watch root and, for a directory, everything the walker enters below it
+void watch_tree(struct watch *watch, const char *root) {
+	struct stat st;
+	if (stat(root, &st) == -1) {
+		fprintf(stderr, "-%s: watch-run: %s: %s\n", sysname, root, strerror(errno));
+		return;
+	}
+	if (S_ISDIR(st.st_mode))
+		walker_run(&watch->walker, root);
+	else
+		watch_add(watch, root);
+}
+
+//root the path was found under, NULL for a watched file
+const char *watch_root_of(struct watch *watch, const char *path) {
+	for (int i = 0; i < watch->root_count; i++) {
+		size_t len = strlen(watch->roots[i]);
+		while (len > 1 && watch->roots[i][len - 1] == '/')
+			len--;
+		if (strncmp(path, watch->roots[i], len) == 0 && path[len] == '/')
+			return watch->roots[i];
+	}
+	return NULL;
+}
+
+/**
+ * Read the pending events, adding watches for new directories
+ * @return number of events about files that are not ignored
+ */
+int watch_read_events(struct watch *watch) {
+	char buf[16384] __attribute__((aligned(__alignof__(struct inotify_event))));
+	char path[PATH_MAX];
+	int changes = 0;
+
+	while (1) {
+		ssize_t n = read(watch->fd, buf, sizeof(buf));
+		if (n <= 0)
+			break;
+		for (char *p = buf; p < buf + n;) {
+			struct inotify_event *event = (struct inotify_event *)p;
+			p += sizeof(struct inotify_event) + event->len;
+
+			if (event->mask & IN_Q_OVERFLOW) {
+				// events were lost, look at everything again
+				for (int i = 0; i < watch->root_count; i++)
+					watch_tree(watch, watch->roots[i]);
+				changes++;
+				continue;
+			}
+			if (event->wd < 0 || event->wd >= watch->path_cap || watch->paths[event->wd] == NULL)
+				continue;
+			if (event->mask & IN_IGNORED) {
+				free(watch->paths[event->wd]); // removed along with its directory
+				watch->paths[event->wd] = NULL;
+				continue;
+			}
+			if (event->len == 0) {
+				changes++; // a watched file, or a watched directory itself
+				continue;
+			}
+
+			snprintf(path, sizeof(path), "%s/%s", watch->paths[event->wd], event->name);
+			bool is_dir = event->mask & IN_ISDIR;
+			const char *root = watch_root_of(watch, path);
+			if (root && walker_skips(&watch->walker, root, path, is_dir))
+				continue;
+			if (is_dir && (event->mask & (IN_CREATE | IN_MOVED_TO)))
+				walker_run(&watch->walker, path);
+			changes++;
+		}
+	}
+	return changes;
+}
+
+/**
+ * watch-run [--debounce MS] [paths...] -- cmd args
+ * Run cmd, then again after each burst of changes, until interrupted.
+ */
+int watch_run(struct command_t *command) {
+	int debounce = 200, i;
+	struct watch watch = {0};
+
+	for (i = 1; command->args[i]; i++) {
+		if (strcmp(command->args[i], "--") == 0)
+			break;
+		if (strcmp(command->args[i], "--debounce") == 0 && command->args[i + 1])
+			debounce = atoi(command->args[++i]);
+	}
+	if (command->args[i] == NULL || command->args[i + 1] == NULL || debounce < 0) {
+		fprintf(stderr, "-%s: watch-run: usage: watch-run [--debounce MS] [paths...] -- cmd args\n",
+				sysname);
+		return 2;
+	}
+
+	watch.fd = inotify_init1(IN_NONBLOCK | IN_CLOEXEC);
+	if (watch.fd == -1) {
+		fprintf(stderr, "-%s: watch-run: %s\n", sysname, strerror(errno));
+		return 1;
+	}
+	walker_init(&watch.walker);
+	watch.walker.visit_dir = watch_visit_dir;
+	watch.walker.data = &watch;
+	watch.roots = malloc((i + 1) * sizeof(char *));
+	for (int j = 1; j < i; j++) {
+		if (strcmp(command->args[j], "--debounce") == 0)
+			j++;
+		else
+			watch.roots[watch.root_count++] = command->args[j];
+	}
+	if (watch.root_count == 0)
+		watch.roots[watch.root_count++] = ".";
+	for (int j = 0; j < watch.root_count; j++)
+		watch_tree(&watch, watch.roots[j]);
+
+	struct sigaction action = {0}, old_action;
+	action.sa_handler = watch_interrupt; // no SA_RESTART, poll() has to return
+	sigemptyset(&action.sa_mask);
+	sigaction(SIGINT, &action, &old_action);
+	watch_interrupted = 0;
+
+	struct command_t *inner = command_from_args(command->args + i + 1);
+	struct pollfd pfd = {watch.fd, POLLIN, 0};
+	while (!watch_interrupted) {
+		process_command(inner);
+		fflush(stdout);
+
+		// a replaced file loses its watch, so watched files are added again
+		for (int j = 0; j < watch.root_count; j++) {
+			struct stat st;
+			if (stat(watch.roots[j], &st) == 0 && !S_ISDIR(st.st_mode))
+				watch_add(&watch, watch.roots[j]);
+		}
+
+		// block for the first change, then until a quiet interval
+		int changes = 0, timeout = -1;
+		while (!watch_interrupted) {
+			int ready = poll(&pfd, 1, timeout);
+			if (ready == -1 && errno != EINTR)
+				break;
+			if (ready == 0)
+				break;
+			if (ready == 1)
+				changes += watch_read_events(&watch);
+			if (changes > 0)
+				timeout = debounce;
+		}
+	}
+	int status = last_status;
+
+	sigaction(SIGINT, &old_action, NULL);
+	free_command(inner);
+	for (int j = 0; j < watch.path_cap; j++)
+		free(watch.paths[j]);
+	free(watch.paths);
+	free(watch.roots);
+	walker_free(&watch.walker);
+	close(watch.fd);
+	return status;
+}
+
+int compare_alias_names(const void *a, const void *b) {
+	return strcmp((*(struct alias *const *)a)->name, (*(struct alias *const *)b)->name);
+}
 
-    DIR *dir = opendir(drc);
-    if (dir == NULL) {
-        return;
-    }
+void print_alias(const struct alias *a) {
+	printf("alias %s='%s'\n", a->name, a->value);
+}
 
-    struct dirent *entry;
-    char path[1500];
-    const char *extension;
+/**
+ * alias [name[=value]...]
+ * Lines are split on blanks before builtins see them, so words without
+ * '=' continue the value before them: alias ll='ls -l' works.
+ */
+int alias(struct command_t *command) {
+	if (command->args[1] == NULL) {
+		struct alias **all = malloc((alias_count + 1) * sizeof(struct alias *));
+		int n = 0;
+		for (int b = 0; b < ALIAS_BUCKETS; b++) {
+			for (struct alias *a = aliases[b]; a; a = a->next)
+				all[n++] = a;
+		}
+		qsort(all, n, sizeof(struct alias *), compare_alias_names);
+		for (int i = 0; i < n; i++)
+			print_alias(all[i]);
+		free(all);
+		return 0;
+	}
 
-    while ((entry = readdir(dir)) != NULL) {
-        if (strcmp(entry->d_name, ".") == 0 || strcmp(entry->d_name, "..") == 0) {
-            continue; // skip current and parent directory links
-        }
-        snprintf(path, sizeof(path), "%s/%s", drc, entry->d_name);
+	int status = 0;
+	for (int i = 1; command->args[i];) {
+		char *arg = command->args[i++];
+		char *eq = strchr(arg, '=');
+		if (eq == NULL) {
+			struct alias *a = alias_find(arg, strlen(arg));
+			if (a)
+				print_alias(a);
+			else {
+				fprintf(stderr, "-%s: alias: %s: not found\n", sysname, arg);
+				status = 1;
+			}
+			continue;
+		}
 
-        if (entry->d_type == DT_DIR) {
-            // recursively count lines in subdirectory
-            cloc_recursive_helper(path, c, cpp, h, hpp, python, txt, info);
-        } else if (entry->d_type == DT_REG) {
-            extension = strrchr(entry->d_name, '.');
-            if (extension == NULL) {
-                extension = ".txt";
-            }
+		struct strbuf value = {0};
+		strbuf_puts(&value, eq + 1);
+		for (; command->args[i] && strchr(command->args[i], '=') == NULL; i++) {
+			strbuf_puts(&value, " ");
+			strbuf_puts(&value, command->args[i]);
+		}
+		char *name = strndup(arg, eq - arg), quote;
+		if (*name == '\0' || strpbrk(name, " \t|/") != NULL) {
+			fprintf(stderr, "-%s: alias: %s: invalid alias name\n", sysname, name);
+			status = 1;
+		} else {
+			alias_set(name, rc_unquote(value.data ? value.data : "", &quote));
+		}
+		free(name);
+		free(value.data);
+	}
+	return status;
+}
 
-            if (!(strcmp(extension, ".c") == 0 || strcmp(extension, ".h") == 0 || strcmp(extension, ".cpp") == 0 ||
-                  strcmp(extension, ".hpp") == 0 || strcmp(extension, ".py") == 0 || strcmp(extension, ".txt") == 0)) {
-                continue; //skip this iteration
-            } else {
-                //file operations
-                FILE *file = fopen(path, "r");
-                if (file == NULL) {
-                    continue;
-                }
-                char line[1024];
-                //to check if it is a comment or blank
-                int comment = 0; //to check if code is in comment
-                int blank = 0;
-                int code = 0;
-
-                while (1) {
-                    if (fgets(line, 1024, file) == NULL) {
-                        break;
-                    }
-                    int lc = 0;
-                    //to increase line count if the char is blank or tab
-                    while ((line[lc] == ' ') || (line[lc] == '\t')) {
-                        lc++;
-                    }
-
-                    //check the blank lines
-                    if (line[lc] == '\n' || line[lc] == '\r' || line[lc] == '\0') {
-                        blank += 1;
-                    } else {
-                        if (strcmp(extension, ".py") == 0) {
-                            if (line[lc] == '#') {
-                                comment++;
-                            } else {
-                                code++;
-                            }
-                        } else {
-                            //to check the comments
-                            //for c and c++ inline comments
-                            if (line[lc] == '/' && line[lc + 1] == '/') {
-                                comment++;
-                            } else if (line[lc] == '/' && line[lc + 1] == '*') {
-                                comment++;
-                            } else {
-                                code++;
-                            }
-                        }
-                    }
-                }
+//unalias -a | name...
+int unalias(struct command_t *command) {
+	if (command->args[1] == NULL) {
+		fprintf(stderr, "-%s: unalias: usage: unalias [-a] name [name ...]\n", sysname);
+		return 2;
+	}
+	if (strcmp(command->args[1], "-a") == 0) {
+		for (int b = 0; b < ALIAS_BUCKETS; b++) {
+			while (aliases[b])
+				alias_remove(aliases[b]->name);
+		}
+		return 0;
+	}
+	int status = 0;
+	for (int i = 1; command->args[i]; i++) {
+		if (!alias_remove(command->args[i])) {
+			fprintf(stderr, "-%s: unalias: %s: not found\n", sysname, command->args[i]);
+			status = 1;
+		}
+	}
+	return status;
+}
 
-                if (strcmp(extension, ".c") == 0) {
-                    c->blank += blank;
-                    c->comment += comment;
-                    c->code += code;
-                    c->files++;
-                } else if (strcmp(extension, ".h") == 0) {
-                    h->blank += blank;
-                    h->comment += comment;
-                    h->code += code;
-                    h->files++;
-                } else if (strcmp(extension, ".cpp") == 0) {
-                    cpp->blank += blank;
-                    cpp->comment += comment;
-                    cpp->code += code;
-                    cpp->files++;
-                } else if (strcmp(extension, ".hpp") == 0) {
-                    hpp->blank += blank;
-                    hpp->comment += comment;
-                    hpp->code += code;
-                    hpp->files++;
-                } else if (strcmp(extension, ".py") == 0) {
-                    python->blank += blank;
-                    python->comment += comment;
-                    python->code += code;
-                    python->files++;
-                } else if (strcmp(extension, ".txt") == 0) {
-                    txt->blank += blank;
-                    txt->comment += comment;
-                    txt->code += code;
-                    txt->files++;
-                }
-                fclose(file);
-                info->files++;
-                info->blank += blank;
-                info->comment += comment;
-                info->code += code;
-            }
-        }
-    }
+//every name process_builtin() handles besides the core builtins
+const char *builtin_names[] = {"cd", "roll", "cdh", "cloc", "sandstorm",
+							   "fortune", "memo", "on", "watch-run", "alias", "unalias",
+							   "psvis", "exit", NULL};
+
+bool is_builtin(const char *name) {
+	if (find_core_builtin(name) != NULL)
+		return true;
+	for (int i = 0; builtin_names[i]; i++) {
+		if (strcmp(name, builtin_names[i]) == 0)
+			return true;
+	}
+	return false;
 }
 
+/*
+ * "command not found" suggestions. Every executable name on PATH and
+ * every builtin goes into a BK-tree under Levenshtein distance: a child
+ * hangs off its parent by their distance, so by the triangle inequality
+ * a search within k of the typed name only descends into children whose
+ * edge is within k of the parent's distance, a small part of the tree.
+ * The tree is built on the first miss and rebuilt when PATH or the mtime
+ * of one of its directories changes.
+ */
+struct bk_node {
+	size_t word; // offset in bk_words
+	int child; // first child, -1 if none
+	int sibling; // next child of the same parent
+	int distance; // to the parent
+};
 
-void cloc(char *drc) {
+struct bk_node *bk_nodes = NULL;
+int bk_count = 0, bk_cap = 0;
+struct strbuf bk_words = {0};
+char *bk_path_var = NULL; // PATH the tree was built from
+struct timespec *bk_mtimes = NULL; // of each PATH entry, in order
+int bk_dir_count = 0;
 
-    //initializing the structs
-    struct Info *info = (struct Info *) malloc(sizeof(struct Info));
-    strcpy(info->name, " ");
-    info->files = 0;
-    info->blank = 0;
-    info->comment = 0;
-    info->code = 0;
-
-    struct Info *python = (struct Info *) malloc(sizeof(struct Info));
-    strcpy(python->name, "Python");
-    python->files = 0;
-    python->blank = 0;
-    python->comment = 0;
-    python->code = 0;
-
-    struct Info *c = (struct Info *) malloc(sizeof(struct Info));
-    strcpy(c->name, "C");
-    c->files = 0;
-    c->blank = 0;
-    c->comment = 0;
-    c->code = 0;
-
-    struct Info *cpp = (struct Info *) malloc(sizeof(struct Info));
-    strcpy(cpp->name, "C++");
-    cpp->files = 0;
-    cpp->blank = 0;
-    cpp->comment = 0;
-    cpp->code = 0;
-
-    struct Info *h = (struct Info *) malloc(sizeof(struct Info));
-    strcpy(h->name, "C Header File");
-    h->files = 0;
-    h->blank = 0;
-    h->comment = 0;
-    h->code = 0;
-
-    struct Info *hpp = (struct Info *) malloc(sizeof(struct Info));
-    strcpy(hpp->name, "C++ Header File");
-    hpp->files = 0;
-    hpp->blank = 0;
-    hpp->comment = 0;
-    hpp->code = 0;
-
-    struct Info *txt = (struct Info *) malloc(sizeof(struct Info));
-    strcpy(txt->name, "Text");
-    txt->files = 0;
-    txt->blank = 0;
-    txt->comment = 0;
-    txt->code = 0;
-
-    cloc_recursive_helper(drc, c, cpp, h, hpp, python, txt, info);
+#define BK_MAX_WORD 64
 
-    //totals
-    printf("Total number of files in the given directory: %d\n", info->files);
-    printf("\n");
-    printf("Total blank lines %d\n",info->blank);
-    printf("Total comment lines %d\n",info->comment);
-    printf("Total code lines %d\n",info->code);
-    printf("\n");
-    //headers
-    printf("%-20s %-10s %-10s %-10s %-10s\n", "Language", "Files", "Blank", "Comment","Code");
-    printf("%-20s %-10d %-10d %-10d %-10d\n", c->name, c->files, c->blank, c->comment,c->code);
-    printf("%-20s %-10d %-10d %-10d %-10d\n", h->name, h->files, h->blank, h->comment,h->code);
-    printf("%-20s %-10d %-10d %-10d %-10d\n", cpp->name, cpp->files, cpp->blank, cpp->comment,cpp->code);
-    printf("%-20s %-10d %-10d %-10d %-10d\n", hpp->name, hpp->files, hpp->blank, hpp->comment,hpp->code);
-    printf("%-20s %-10d %-10d %-10d %-10d\n", python->name, python->files, python->blank, python->comment,python->code);
-    printf("%-20s %-10d %-10d %-10d %-10d\n", txt->name, txt->files, txt->blank, txt->comment,txt->code);
+/*
+ * Levenshtein distance from one fixed word to many others, bit-parallel
+ * (Myers/Hyyro): each column of the DP table is a pair of 64 bit vectors,
+ * so a comparison costs a few word operations per letter of the other
+ * word. Words are at most BK_MAX_WORD = 64 letters.
+ */
+struct distance_from {
+	uint64_t peq[256]; // positions of each byte in the word
+	int len;
+};
+
+void distance_prepare(struct distance_from *from, const char *word) {
+	memset(from->peq, 0, sizeof(from->peq));
+	from->len = strlen(word);
+	for (int i = 0; i < from->len; i++)
+		from->peq[(unsigned char)word[i]] |= 1ULL << i;
 }
 
-//custom command 1
-void sandstorm() {
-    char cmd[100];
-    char *url=("https://www.youtube.com/watch?v=y6120QOlsfU");
-#ifdef __APPLE__
-    sprintf(cmd,"open %s", url);
-#elif _WIN32
-    sprintf(cmd,"start %s", url);
+int distance_to(const struct distance_from *from, const char *word) {
+	int m = from->len, score = m;
+	if (m == 0)
+		return strlen(word);
+
+	uint64_t pv = ~0ULL, mv = 0, last = 1ULL << (m - 1);
+	for (; *word; word++) {
+		uint64_t eq = from->peq[(unsigned char)*word];
+		uint64_t xv = eq | mv;
+		uint64_t xh = (((eq & pv) + pv) ^ pv) | eq;
+		uint64_t ph = mv | ~(xh | pv);
+		uint64_t mh = pv & xh;
+		if (ph & last)
+			score++;
+		else if (mh & last)
+			score--;
+		ph = (ph << 1) | 1;
+		mh <<= 1;
+		pv = mh | ~(xv | ph);
+		mv = ph & xv;
+	}
+	return score;
+}
 
-#else
-    sprintf(cmd,"xdg-open %s", url);
-#endif
-    system(cmd);
+//Levenshtein distance that also counts swapping two neighbours as one edit
+int transposition_distance(const char *a, const char *b) {
+	int la = strlen(a), lb = strlen(b);
+	int rows[3][BK_MAX_WORD + 1]; // row i of the table is rows[(i + 1) % 3]
+	if (la > BK_MAX_WORD || lb > BK_MAX_WORD)
+		return INT_MAX;
+
+	for (int j = 0; j <= lb; j++)
+		rows[1][j] = j;
+	for (int i = 1; i <= la; i++) {
+		int *prev2 = rows[(i + 2) % 3], *prev = rows[i % 3], *row = rows[(i + 1) % 3];
+		row[0] = i;
+		for (int j = 1; j <= lb; j++) {
+			int best = prev[j - 1] + (a[i - 1] != b[j - 1]);
+			if (prev[j] + 1 < best)
+				best = prev[j] + 1;
+			if (row[j - 1] + 1 < best)
+				best = row[j - 1] + 1;
+			if (i > 1 && j > 1 && a[i - 1] == b[j - 2] && a[i - 2] == b[j - 1] &&
+				prev2[j - 2] + 1 < best)
+				best = prev2[j - 2] + 1;
+			row[j] = best;
+		}
+	}
+	return rows[(la + 1) % 3][lb];
 }
 
-//custom command 2
-void fortune() {
-    char fortunes[25][256] = {"You will encounter a coding bug so bizarre, you'll start to wonder if your computer is possessed by a mischievous spirit.\n", "Your future holds a plethora of keyboard shortcuts that will make you feel like a wizard of the digital realm.\n", "In your future, you will finally solve a programming problem that's been driving you crazy - just in time for it to become obsolete.\n",
-                         "Your computer will crash at the most inconvenient time possible, reminding you that technology truly has a sense of humor.\n", "The code you write today will run perfectly - but only on the machine you wrote it on. Good luck :).\n", "\"In the near future, you will discover the joys of pointer arithmetic in C. Don't worry, it's not as painful as it sounds.\n",
-                         "You will encounter a bug in your C code that will make you question the fundamental laws of computer science.\n", "Your mastery of C will impress even the most seasoned programmers, earning you the nickname 'C-sar' among your peers.\n", "Your code will compile without errors, but when you run it, you'll be greeted with a delightful surprise: a segfault!\n",
-                         "You will spend hours debugging a single line of code in C, only to find that the problem was caused by a misplaced semicolon.\n", "In the near future, you will experience the joy of watching an operating system update progress bar move at an excruciatingly slow pace\n", "You will encounter a mysterious error message while working with your operating system, leaving you wondering if the Matrix has just glitched.\n",
-                         "Your future holds a visit to the dreaded Blue Screen of Death. Don't worry, it happens to the best of us. \n"," You will discover a hidden Easter egg in your operating system that will make you question whether the developers have a sense of humor or not.\n","Your operating system will suddenly decide to update itself in the middle of an important task, leaving you with a newfound appreciation for manual updates.\n","You will encounter the Linux terminal for the first time and feel like you've been transported to a world of endless possibilities.\n",
-                         "Your future holds a late-night session of compiling and installing packages from source code, leaving you feeling like a true Linux guru.\n", "You will experience the satisfaction of solving a complex problem using Linux command-line tools, and wonder how you ever lived without them.\n", "Your Linux system will crash unexpectedly, but fear not - with the power of the command line, you'll be able to diagnose and fix the issue in no time.\n", "You will discover the joys of customizing your Linux desktop environment, creating a unique setup that reflects your personality and style\n",
-                         "You will become so proficient in Vim that you'll start editing text in your dreams with HJKL\n","In the future, you'll accidentally activate Vim's 'delete everything' mode and be left wondering if your document ever existed.\n","You'll become so comfortable using Vim that you'll start seeing regular text editors as mere toys.\n","You will encounter a fellow Vim user and bond over your mutual love for efficient editing and obscure keyboard shortcuts.\n","Your future holds a moment of panic when you realize you can't exit Vim, but fear not - Google and the Vim community will come to your rescue.\n"
-    };
+void bk_insert(const char *word) {
+	struct distance_from from;
+	if (strlen(word) > BK_MAX_WORD)
+		return;
+	distance_prepare(&from, word);
+
+	int parent = -1, d = 0;
+	for (int node = bk_count ? 0 : -1; node != -1;) {
+		d = distance_to(&from, bk_words.data + bk_nodes[node].word);
+		if (d == 0)
+			return; // the same name in two PATH directories
+		parent = node;
+		for (node = bk_nodes[parent].child; node != -1; node = bk_nodes[node].sibling) {
+			if (bk_nodes[node].distance == d)
+				break;
+		}
+	}
 
-    int random_fortune = rand() % 25;
-    printf("%s", fortunes[random_fortune]);
+	if (bk_count == bk_cap) {
+		bk_cap = bk_cap ? bk_cap * 2 : 1024;
+		bk_nodes = realloc(bk_nodes, bk_cap * sizeof(struct bk_node));
+	}
+	struct bk_node *n = &bk_nodes[bk_count];
+	n->word = bk_words.len;
+	n->child = -1;
+	n->distance = d;
+	n->sibling = parent == -1 ? -1 : bk_nodes[parent].child;
+	if (parent != -1)
+		bk_nodes[parent].child = bk_count;
+	bk_count++;
+	strbuf_append(&bk_words, word, strlen(word) + 1);
 }
 
-void psvis(pid_t pid) { //add output file
+//the entries of PATH, each with its mtime, or -1 seconds if it is missing
+int path_dir_mtimes(const char *path_var, struct timespec **mtimes) {
+	int count = 0;
+	*mtimes = NULL;
+	for (const char *dir = path_var; dir;) {
+		const char *end = strchr(dir, ':');
+		int len = end ? (int)(end - dir) : (int)strlen(dir);
+		char path[PATH_MAX];
+		struct stat st;
+		snprintf(path, sizeof(path), "%.*s", len, len ? dir : ".");
+		*mtimes = realloc(*mtimes, (count + 1) * sizeof(struct timespec));
+		if (stat(path, &st) == 0)
+			(*mtimes)[count] = st.st_mtim;
+		else
+			(*mtimes)[count] = (struct timespec){-1, 0};
+		count++;
+		dir = end ? end + 1 : NULL;
+	}
+	return count;
+}
 
-    struct ast_node* get_ast_for_pid(pid);
+//make sure the tree matches PATH and the directories in it
+void bk_refresh() {
+	const char *path_var = getenv("PATH");
+	if (path_var == NULL)
+		path_var = "";
+	struct timespec *mtimes;
+	int count = path_dir_mtimes(path_var, &mtimes);
+
+	if (bk_path_var && strcmp(bk_path_var, path_var) == 0 && count == bk_dir_count &&
+		memcmp(mtimes, bk_mtimes, count * sizeof(struct timespec)) == 0) {
+		free(mtimes);
+		return;
+	}
 
+	free(bk_path_var);
+	free(bk_mtimes);
+	bk_path_var = strdup(path_var);
+	bk_mtimes = mtimes;
+	bk_dir_count = count;
+	bk_count = 0;
+	bk_words.len = 0;
+
+	for (size_t i = 0; i < sizeof(core_builtins) / sizeof(core_builtins[0]); i++)
+		bk_insert(core_builtins[i].name);
+	for (int i = 0; builtin_names[i]; i++)
+		bk_insert(builtin_names[i]);
+
+	for (const char *dir = path_var; dir;) {
+		const char *end = strchr(dir, ':');
+		int len = end ? (int)(end - dir) : (int)strlen(dir);
+		char path[PATH_MAX];
+		snprintf(path, sizeof(path), "%.*s", len, len ? dir : ".");
+		DIR *d = opendir(path);
+		struct dirent *entry;
+		while (d && (entry = readdir(d)) != NULL) {
+			// directories are not commands, other types are not checked
+			if (entry->d_name[0] != '.' && entry->d_type != DT_DIR)
+				bk_insert(entry->d_name);
+		}
+		if (d)
+			closedir(d);
+		dir = end ? end + 1 : NULL;
+	}
 }
 
-int process_command(struct command_t *command) {
-	int r;
+#define SUGGESTIONS 3
 
-	if (strcmp(command->name, "") == 0) {
-		return SUCCESS;
+/**
+ * Print the known commands closest to name, if any are close enough
+ */
+void suggest_commands(const char *name, FILE *out) {
+	int len = strlen(name);
+	if (len == 0 || len > BK_MAX_WORD)
+		return;
+	bk_refresh();
+	if (bk_count == 0)
+		return;
+
+	struct distance_from from;
+	distance_prepare(&from, name);
+	int limit = len <= 2 ? 1 : 2;
+	int best[SUGGESTIONS], best_distance[SUGGESTIONS], found = 0;
+	int *stack = malloc(bk_count * sizeof(int)), top = 0;
+	stack[top++] = 0;
+	while (top > 0) {
+		struct bk_node *n = &bk_nodes[stack[--top]];
+		const char *word = bk_words.data + n->word;
+		int d = distance_to(&from, word);
+
+		if (d <= limit) {
+			// ranked by the distance that forgives swapped letters, "gti"
+			// is one edit from "git" but two from "gcc"
+			int score = transposition_distance(name, word);
+			int i = found < SUGGESTIONS ? found++ : SUGGESTIONS;
+			while (i > 0 && (best_distance[i - 1] > score ||
+							 (best_distance[i - 1] == score &&
+							  strcmp(bk_words.data + bk_nodes[best[i - 1]].word, word) > 0))) {
+				if (i < SUGGESTIONS) {
+					best[i] = best[i - 1];
+					best_distance[i] = best_distance[i - 1];
+				}
+				i--;
+			}
+			if (i < SUGGESTIONS) {
+				best[i] = n - bk_nodes;
+				best_distance[i] = score;
+			}
+		}
+		for (int c = n->child; c != -1; c = bk_nodes[c].sibling) {
+			if (bk_nodes[c].distance >= d - limit && bk_nodes[c].distance <= d + limit)
+				stack[top++] = c;
+		}
 	}
+	free(stack);
+
+	if (found == 0)
+		return;
+	fprintf(out, "Did you mean:");
+	for (int i = 0; i < found; i++)
+		fprintf(out, "%s %s", i ? "," : "", bk_words.data + bk_nodes[best[i]].word);
+	fprintf(out, "\n");
+}
 
+/**
+ * Build the suggestion tree in the shell before forking a command that
+ * will not be found. The child prints the suggestions, and the tree it
+ * inherits stays with the shell for the next miss instead of being built
+ * in the child and thrown away.
+ */
+void prepare_suggestions(struct command_t *command) {
+	if (command->name[0] != '\0' && !is_builtin(command->name) &&
+		find_executable(command) == UNKNOWN)
+		bk_refresh();
+}
 
-	if (strcmp(command->name, "exit") == 0) {
-		return EXIT;
+/**
+ * Run a builtin command in the current process, its exit status goes to
+ * last_status
+ * @param  command [description]
+ * @return         UNKNOWN if the command is not a builtin
+ */
+int process_builtin(struct command_t *command) {
+	int r;
+
+	struct core_builtin *core = find_core_builtin(command->name);
+	if (core != NULL) {
+		last_status = core->run(command);
+		return SUCCESS;
 	}
+	last_status = 0;
 
 	if (strcmp(command->name, "cd") == 0) {
 		if (command->arg_count > 0) {
@@ -862,7 +5603,7 @@ int process_command(struct command_t *command) {
 	}
 
 	if (strcmp(command->name, "roll") == 0) {
-		roll(command->args[1]);
+		last_status = roll(command);
 		return SUCCESS;
 	}
 
@@ -872,7 +5613,7 @@ int process_command(struct command_t *command) {
 	}
 
     if (strcmp(command->name, "cloc") == 0) {
-        cloc(command->args[1]);
+        last_status = cloc(command);
         return SUCCESS;
     }
 
@@ -882,10 +5623,35 @@ int process_command(struct command_t *command) {
     }
 
     if (strcmp(command->name, "fortune") == 0) {
-        fortune();
+        last_status = fortune(command);
         return SUCCESS;
     }
 
+	if (strcmp(command->name, "memo") == 0) {
+		last_status = memo(command);
+		return SUCCESS;
+	}
+
+	if (strcmp(command->name, "on") == 0) {
+		last_status = on(command);
+		return SUCCESS;
+	}
+
+	if (strcmp(command->name, "watch-run") == 0) {
+		last_status = watch_run(command);
+		return SUCCESS;
+	}
+
+	if (strcmp(command->name, "alias") == 0) {
+		last_status = alias(command);
+		return SUCCESS;
+	}
+
+	if (strcmp(command->name, "unalias") == 0) {
+		last_status = unalias(command);
+		return SUCCESS;
+	}
+
     if (strcmp(command->name, "psvis") == 0) {
         if (command->arg_count > 0) {
             //psvis(atoi(command->args[1]));
@@ -893,115 +5659,367 @@ int process_command(struct command_t *command) {
         return SUCCESS;
     }
 
-	//if not found
-	if (find_executable(command) == UNKNOWN) {
-		printf("-%s: %s: command not found\n", sysname, command->name);
-		return UNKNOWN;
-	}
-
-	pid_t pid = fork();
+	return UNKNOWN;
+}
 
-	//redirection
+/**
+ * Apply the in/out redirections of a command to the current process
+ * @return SUCCESS or UNKNOWN if a file could not be opened
+ */
+int apply_redirects(struct command_t *command) {
+	int flags[3] = {O_RDONLY, O_WRONLY | O_CREAT | O_TRUNC, O_WRONLY | O_CREAT | O_APPEND};
+	int targets[3] = {STDIN_FILENO, STDOUT_FILENO, STDOUT_FILENO};
 
-	//input file redirection (read)
-	int fd;
-	if (command->redirects[0]!= NULL) {
-		fd = open(command->redirects[0], O_RDONLY);
+	for (int i = 0; i < 3; i++) {
+		if (command->redirects[i] == NULL)
+			continue;
+		int fd = open(command->redirects[i], flags[i], 0644);
 		if (fd == -1) {
-			perror("open");
-			exit(EXIT_FAILURE);
+			fprintf(stderr, "-%s: %s: %s\n", sysname, command->redirects[i],
+					strerror(errno));
+			return UNKNOWN;
 		}
-
+		if (dup2(fd, targets[i]) == -1) {
+			perror("dup2");
+			close(fd);
+			return UNKNOWN;
+		}
+		close(fd);
 	}
+	return SUCCESS;
+}
+
+/**
+ * Point the shell's own stdin/stdout at a builtin's redirections, and at
+ * out_fd (a pipe) when it is not -1, so the builtin runs without a fork
+ * @param  saved receives the previous descriptors for restore_builtin_io()
+ * @return       SUCCESS or UNKNOWN if a redirection failed
+ */
+int redirect_builtin_io(struct command_t *command, int out_fd, int saved[2]) {
+	saved[0] = saved[1] = -1;
+	if (out_fd == -1 && !command->redirects[0] && !command->redirects[1] &&
+		!command->redirects[2])
+		return SUCCESS;
 
-	//output file redirection
+	fflush(stdout);
+	saved[0] = dup(STDIN_FILENO);
+	saved[1] = dup(STDOUT_FILENO);
+	if (out_fd != -1)
+		dup2(out_fd, STDOUT_FILENO);
+	// a closed reader must fail the write, not kill the shell
+	signal(SIGPIPE, SIG_IGN);
+	return apply_redirects(command);
+}
 
-	int fd1;
-	int fd2;
+void restore_builtin_io(int saved[2]) {
+	if (saved[0] == -1)
+		return;
+	fflush(stdout);
+	clearerr(stdout);
+	signal(SIGPIPE, SIG_DFL);
+	dup2(saved[0], STDIN_FILENO);
+	dup2(saved[1], STDOUT_FILENO);
+	close(saved[0]);
+	close(saved[1]);
+}
 
-	//for write
-	if (command->redirects[1]!= NULL) {
-		fd1 = open(command->redirects[1], O_WRONLY | O_CREAT | O_TRUNC, 0644);
-		if (fd1 == -1) {
-			perror("open");
-			exit(EXIT_FAILURE);
-		}
+/**
+ * Run a builtin inside the shell with its redirections applied, its exit
+ * status goes to last_status
+ * @param  out_fd pipe to write into, -1 for stdout
+ * @return        UNKNOWN if the command is not a builtin
+ */
+int run_builtin_in_shell(struct command_t *command, int out_fd) {
+	int saved[2], r = SUCCESS;
+	if (redirect_builtin_io(command, out_fd, saved) == UNKNOWN) {
+		last_status = 1;
+	} else {
+		r = process_builtin(command);
 	}
-	//for append
-	if (command->redirects[2]!= NULL) {
-		fd2 = open(command->redirects[2], O_WRONLY | O_CREAT | O_APPEND, 0644);
-		if (fd2 == -1) {
-			perror("open");
-			exit(EXIT_FAILURE);
+	restore_builtin_io(saved);
+	return r;
+}
+
+/**
+ * Launch a resolved external command through the zygote. Redirections
+ * are opened here and passed along with the other descriptors.
+ * @return pid, 0 if a redirection failed, -1 to fall back to fork()
+ */
+pid_t zygote_launch(struct command_t *command, int in_fd, int out_fd) {
+	int flags[3] = {O_RDONLY, O_WRONLY | O_CREAT | O_TRUNC, O_WRONLY | O_CREAT | O_APPEND};
+	int fds[3] = {in_fd, out_fd, STDERR_FILENO};
+	int opened[3] = {-1, -1, -1};
+
+	for (int i = 0; i < 3; i++) {
+		if (command->redirects[i] == NULL)
+			continue;
+		opened[i] = open(command->redirects[i], flags[i] | O_CLOEXEC, 0644);
+		if (opened[i] == -1) {
+			fprintf(stderr, "-%s: %s: %s\n", sysname, command->redirects[i],
+					strerror(errno));
+			for (int j = 0; j < i; j++)
+				close(opened[j]);
+			return 0;
 		}
+		fds[i == 0 ? 0 : 1] = opened[i];
 	}
 
-	// child
-	if (pid == 0) {
+	pid_t pid = zygote_spawn(command->args[0], command->args, fds, command->sched);
+	for (int i = 0; i < 3; i++) {
+		if (opened[i] != -1)
+			close(opened[i]);
+	}
+	return pid;
+}
+
+int run_pipeline(struct command_t *command);
 
+/**
+ * Leave a forked child. _exit() keeps stdio from syncing the file offset
+ * of a script read on stdin, which the shell still shares.
+ */
+void exit_child(int status) {
+	fflush(stdout);
+	fflush(stderr);
+	_exit(status);
+}
 
-        printf("%d\n",getpid());
-		/// This shows how to do exec with environ (but is not available on MacOs)
-		// extern char** environ; // environment variables
-		// execvpe(command->name, command->args, environ); // exec+args+path+environ
+/**
+ * Turn the current (forked) process into the given command, never returns
+ * @param command [description]
+ */
+void exec_command(struct command_t *command) {
+	if (command->next) {
+		run_pipeline(command);
+		exit_child(last_status);
+	}
 
-		/// This shows how to do exec with auto-path resolve
-		// add a NULL argument to the end of args, and the name to the beginning
-		// as required by exec
+	if (apply_redirects(command) == UNKNOWN)
+		exit_child(EXIT_FAILURE);
 
-		// TODO: do your own exec with path resolving using execv()
-		// do so by replacing the execvp call below
-		//char *cmd[] = {"/usr/bin/ls", "-l", NULL};
+	if (strcmp(command->name, "") == 0)
+		exit_child(0);
 
-		execv(command->args[0], command->args); // exec+args+path
-		exit(0);
-	} else {
-        printf("child");
+	if (process_builtin(command) != UNKNOWN)
+		exit_child(last_status);
 
-        wait(NULL);
+	if (find_executable(command) == UNKNOWN) {
+		fprintf(stderr, "-%s: %s: command not found\n", sysname, command->name);
+		suggest_commands(command->name, stderr);
+		exit_child(127);
 	}
 
-    //to reach childs of the parent
+	execv(command->args[0], command->args);
+	fprintf(stderr, "-%s: %s: %s\n", sysname, command->name, strerror(errno));
+	exit_child(126);
+}
 
-	if (!command->background) {
-		wait(0);
+/**
+ * Wait for a foreground child and record its exit status
+ */
+void wait_child(pid_t pid) {
+	int status;
+	while (waitpid(pid, &status, 0) == -1) {
+		if (errno == ECHILD && zygote_available()) {
+			// launched by the zygote, not our child
+			status = zygote_wait(pid);
+			if (status == -1)
+				return;
+			break;
+		}
+		if (errno != EINTR)
+			return;
 	}
+	if (WIFEXITED(status))
+		last_status = WEXITSTATUS(status);
+	else if (WIFSIGNALED(status))
+		last_status = 128 + WTERMSIG(status);
+}
 
-	//duplicating and closing read file
-	if (command->redirects[0]!= NULL) {
-		if (dup2(fd, STDIN_FILENO) == -1) {
-			perror("dup2");
-			exit(EXIT_FAILURE);
+/**
+ * Run a pipeline, stage i writing into the pipe stage i+1 reads from.
+ * Core builtins run inside the shell after the other stages are forked,
+ * so a pipeline made of them never forks.
+ * @param  command first stage
+ * @return         SUCCESS
+ */
+int run_pipeline(struct command_t *command) {
+	int stages = 0;
+	for (struct command_t *c = command; c; c = c->next)
+		stages++;
+
+	pid_t *pids = malloc(stages * sizeof(pid_t));
+	int (*fds)[2] = malloc(stages * sizeof(*fds)); // fds[i]: stage i -> i+1
+	bool *in_shell = malloc(stages * sizeof(bool));
+	int i, n = 0;
+	struct command_t *c;
+
+	for (i = 0, c = command; c; i++, c = c->next) {
+		// a stage with "on" settings needs a process of its own, and so
+		// does every stage of a background pipeline
+		in_shell[i] = find_core_builtin(c->name) != NULL && c->sched == NULL &&
+					  !command->background;
+		fds[i][0] = fds[i][1] = -1;
+		if (c->next && pipe(fds[i]) == -1) {
+			// run what is connected; the command may be a cached one,
+			// its list is left alone
+			perror("pipe");
+			stages = i + 1;
+			break;
 		}
-		if (close(fd) == -1) {
-			perror("close");
-			exit(EXIT_FAILURE);
+	}
+	// in-shell stages never read stdin, nobody drains their input pipe
+	for (i = 1; i < stages; i++) {
+		if (in_shell[i] && fds[i - 1][0] != -1) {
+			close(fds[i - 1][0]);
+			fds[i - 1][0] = -1;
 		}
 	}
 
-	//duplicating and closing write file
+	fflush(stdout);
+	for (i = 0, c = command; i < stages; i++, c = c->next) {
+		if (in_shell[i])
+			continue;
+		prepare_suggestions(c);
+
+		// process substitutions are not visible to the zygote
+		if (zygote_available() && subst_count == 0 && !is_builtin(c->name) &&
+			find_executable(c) == SUCCESS) {
+			pid_t pid = zygote_launch(c, i > 0 ? fds[i - 1][0] : STDIN_FILENO,
+									  i + 1 < stages ? fds[i][1] : STDOUT_FILENO);
+			if (pid > 0)
+				pids[n++] = pid;
+			if (pid >= 0)
+				continue;
+		}
 
-	if (command->redirects[0]!= NULL) {
-		if (dup2(fd1, STDOUT_FILENO) == -1) {
-			perror("dup2");
-			exit(EXIT_FAILURE);
+		pid_t pid = fork();
+		if (pid == -1) {
+			perror("fork");
+			continue;
 		}
-		if (close(fd1) == -1) {
-			perror("close");
-			exit(EXIT_FAILURE);
+		if (pid == 0) {
+			if (i > 0)
+				dup2(fds[i - 1][0], STDIN_FILENO);
+			if (i + 1 < stages)
+				dup2(fds[i][1], STDOUT_FILENO);
+			for (int j = 0; j < stages; j++) {
+				close(fds[j][0]);
+				close(fds[j][1]);
+			}
+			if (c->sched && apply_sched(c->sched) == -1)
+				exit_child(1);
+			c->next = NULL; // only this stage runs here
+			exec_command(c);
 		}
+		pids[n++] = pid;
 	}
 
-	//duplicating and closing append file
-	if (command->redirects[0]!= NULL) {
-		if (dup2(fd2, STDOUT_FILENO) == -1) {
-			perror("dup2");
-			exit(EXIT_FAILURE);
+	// only the children read now: a reader that exits early must make the
+	// writes of an in-shell stage fail instead of filling the pipe forever
+	for (i = 0; i < stages; i++) {
+		close(fds[i][0]);
+		fds[i][0] = -1;
+		if (!in_shell[i]) {
+			close(fds[i][1]);
+			fds[i][1] = -1;
+		}
+	}
+
+	int status = 0;
+	for (i = 0, c = command; i < stages; i++, c = c->next) {
+		if (in_shell[i]) {
+			run_builtin_in_shell(c, i + 1 < stages ? fds[i][1] : -1);
+			status = last_status;
+		}
+	}
+
+	for (i = 0; i < stages; i++)
+		close(fds[i][1]);
+
+	if (!command->background) {
+		for (i = 0; i < n; i++)
+			wait_child(pids[i]);
+	}
+	// the status of a pipeline is the one of its last stage
+	if (in_shell[stages - 1])
+		last_status = status;
+
+	free(pids);
+	free(fds);
+	free(in_shell);
+	return SUCCESS;
+}
+
+int process_command(struct command_t *command) {
+	if (strcmp(command->name, "") == 0) {
+		return SUCCESS;
+	}
+
+
+	if (strcmp(command->name, "exit") == 0) {
+		return EXIT;
+	}
+
+	if (command->next) {
+		return run_pipeline(command);
+	}
+
+	// with "on" settings a builtin runs in a child, like an external command
+	bool forked_builtin = command->sched != NULL && is_builtin(command->name);
+	if (command->sched == NULL && run_builtin_in_shell(command, -1) != UNKNOWN) {
+		return SUCCESS;
+	}
+
+	//if not found
+	if (!forked_builtin && find_executable(command) == UNKNOWN) {
+		fprintf(stderr, "-%s: %s: command not found\n", sysname, command->name);
+		suggest_commands(command->name, stderr);
+		last_status = 127;
+		return UNKNOWN;
+	}
+
+	// the zygote cannot see the /dev/fd paths of process substitutions
+	if (!forked_builtin && zygote_available() && subst_count == 0) {
+		pid_t pid = zygote_launch(command, STDIN_FILENO, STDOUT_FILENO);
+		if (pid == 0) {
+			last_status = 1;
+			return UNKNOWN;
 		}
-		if (close(fd2) == -1) {
-			perror("close");
-			exit(EXIT_FAILURE);
+		if (pid > 0) {
+			if (!command->background) {
+				wait_child(pid);
+			}
+			return SUCCESS;
+		}
+	}
+
+	fflush(stdout);
+	pid_t pid = fork();
+	if (pid == -1) {
+		perror("fork");
+		return UNKNOWN;
+	}
+
+	// child
+	if (pid == 0) {
+		if (command->sched && apply_sched(command->sched) == -1)
+			exit_child(1);
+		if (forked_builtin)
+			exec_command(command);
+
+		//redirection
+		if (apply_redirects(command) == UNKNOWN) {
+			exit_child(EXIT_FAILURE);
 		}
+
+		execv(command->args[0], command->args); // exec+args+path
+		fprintf(stderr, "-%s: %s: %s\n", sysname, command->name, strerror(errno));
+		exit_child(126);
+	}
+
+	if (!command->background) {
+		wait_child(pid);
 	}
 
 	return SUCCESS;
@@ -0,0 +1,20 @@
+#!/bin/sh
+# cloc regression cases: each directory under tests/cloc must give the
+# blank/comment/code line counts listed here
+cd "$(dirname "$0")" || exit 1
+gcc -O2 -w -o /tmp/mishell_test ../shell-skeleton.c || exit 1
+
+status=0
+check() {
+    got=$(printf 'cloc cloc/%s\nexit\n' "$1" | /tmp/mishell_test |
+          awk -v lang="$2" '$1 == lang { print $3, $4, $5 }')
+    if [ "$got" != "$3" ]; then
+        echo "FAIL $1: expected blank/comment/code $3, got $got"
+        status=1
+    fi
+}
+
+# a raw string over several lines hides a comment token, no escapes in it
+check raw_string Go "1 0 5"
+
+exit $status
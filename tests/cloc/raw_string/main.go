@@ -0,0 +1,6 @@
+package main
+
+var s = `a
+/* x
+b\`
+var t = 1